@@ -0,0 +1,93 @@
+#include <expression_evaluator/batch.hpp>
+#include <expression_evaluator/evaluator.hpp>
+
+#include "bench_util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace {
+namespace batch = expression_evaluator::batch;
+namespace evaluator = expression_evaluator::evaluator;
+
+constexpr size_t LINES = 1000000;
+
+/// @brief A batch of short expressions, one per line, with some errors
+std::string make_input() {
+    const char *const expressions[] = {
+        "1 + 2 * 3", "(4 - 1) / 3 ^ 2", "2 ^ 0.5 > 1.4 && true", "7 / (2 - 2)",
+        "-5 + 10 * 2 - 3", "3.14159 * 2.5 ^ 2", "1 == true", "100 / 4 / 5"};
+
+    std::string input;
+    for (size_t line = 0; line < LINES; line++) {
+        input += expressions[line % std::size(expressions)];
+        input += '\n';
+    }
+
+    return input;
+}
+} // namespace
+
+int main() {
+    bench::Report report("batch");
+
+    const std::string input = make_input();
+    std::FILE *null_stream = std::fopen("/dev/null", "w");
+    std::ofstream null_output("/dev/null");
+    if (null_stream == nullptr || !null_output)
+        return 1;
+
+    // What a line-at-a-time driver does: read a line, print the result or
+    // error, and flush
+    const double line_rate = bench::items_per_second(
+        [&]() {
+            std::istringstream lines(input);
+            std::string line;
+            while (std::getline(lines, line)) {
+                try {
+                    null_output << evaluator::evaluate(line).to_string()
+                                << std::endl;
+                } catch (const std::exception &e) {
+                    null_output << e.what() << std::endl;
+                }
+            }
+        },
+        LINES);
+    report.add("getline_endl", {{"lines_per_second", line_rate}});
+
+    const double batch_rate = bench::items_per_second(
+        [&]() {
+            batch::BufferedWriter output(null_stream);
+            (void)batch::evaluate_lines(input, output);
+        },
+        LINES);
+    report.add("evaluate_lines", {{"lines_per_second", batch_rate}});
+
+    // Scaling of the parallel engine, doubling the thread count up to the
+    // number of hardware threads
+    const unsigned max_threads =
+        std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned threads = 1;; threads = std::min(threads * 2, max_threads)) {
+        const double rate = bench::items_per_second(
+            [&]() {
+                batch::BufferedWriter output(null_stream);
+                (void)batch::evaluate_lines(input, output, threads);
+            },
+            LINES);
+        report.add("evaluate_lines/threads=" + std::to_string(threads),
+                   {{"lines_per_second", rate},
+                    {"speedup", rate / batch_rate}});
+
+        if (threads == max_threads)
+            break;
+    }
+
+    std::fclose(null_stream);
+    report.print();
+    return 0;
+}
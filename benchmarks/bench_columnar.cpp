@@ -0,0 +1,87 @@
+#include <expression_evaluator/columnar.hpp>
+#include <expression_evaluator/compiler.hpp>
+
+#include "bench_util.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+using expression_evaluator::evaluator::Value;
+namespace columnar = expression_evaluator::columnar;
+namespace compiler = expression_evaluator::compiler;
+
+constexpr size_t ROWS = 1 << 20;
+
+const char *kernel_name(columnar::KernelSet kernels) {
+    switch (kernels) {
+    case columnar::KernelSet::SSE2:
+        return "sse2";
+    case columnar::KernelSet::AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+} // namespace
+
+int main() {
+    bench::Report report("columnar");
+
+    std::vector<double> price(ROWS), qty(ROWS), limit(ROWS);
+    for (size_t row = 0; row < ROWS; row++) {
+        price[row] = 1.0 + static_cast<double>(row % 1000) / 10.0;
+        qty[row] = static_cast<double>(row % 37);
+        limit[row] = 500.0 + static_cast<double>(row % 13) * 100.0;
+    }
+
+    const std::string_view layout[] = {"price", "qty", "limit"};
+    const double *columns[] = {price.data(), qty.data(), limit.data()};
+    std::vector<double> output(ROWS);
+
+    for (const std::string_view expression :
+         {"price * qty", "price * qty > limit && qty != 0 || price < 2",
+          "(price - limit / 10) / price * 100 - qty ^ 2"}) {
+        const compiler::CompiledExpression program =
+            compiler::compile(expression, layout);
+
+        const double row_rate = bench::items_per_second(
+            [&]() {
+                Value bindings[] = {Value{0.0}, Value{0.0}, Value{0.0}};
+                for (size_t row = 0; row < ROWS; row++) {
+                    bindings[0] = Value{price[row]};
+                    bindings[1] = Value{qty[row]};
+                    bindings[2] = Value{limit[row]};
+                    const Value result = program.evaluate(bindings);
+                    output[row] = result.is_bool()
+                                      ? (result.as_bool() ? 1.0 : 0.0)
+                                      : result.as_number();
+                }
+            },
+            ROWS);
+        report.add(std::string(expression) + "/row_at_a_time",
+                   {{"rows_per_second", row_rate}});
+
+        for (const columnar::KernelSet kernels :
+             {columnar::KernelSet::SCALAR, columnar::KernelSet::SSE2,
+              columnar::KernelSet::AVX2}) {
+            if (!columnar::is_supported(kernels))
+                continue;
+
+            const double rate = bench::items_per_second(
+                [&]() {
+                    (void)columnar::evaluate(program, columns, ROWS,
+                                             output.data(), kernels);
+                },
+                ROWS);
+            report.add(std::string(expression) + "/columnar_" +
+                           kernel_name(kernels),
+                       {{"rows_per_second", rate},
+                        {"speedup", rate / row_rate}});
+        }
+    }
+
+    report.print();
+    return 0;
+}
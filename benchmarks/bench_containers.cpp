@@ -0,0 +1,80 @@
+#include <expression_evaluator/lexer.hpp>
+#include <expression_evaluator/structures/array_stack.hpp>
+#include <expression_evaluator/structures/queue.hpp>
+#include <expression_evaluator/structures/ring_queue.hpp>
+#include <expression_evaluator/structures/stack.hpp>
+#include <expression_evaluator/token.hpp>
+
+#include "bench_util.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+using expression_evaluator::Token;
+using namespace expression_evaluator::structures;
+namespace lexer = expression_evaluator::lexer;
+
+// Each container is reused across iterations, so that the numbers reflect
+// steady-state access patterns rather than first-touch page faults
+
+/// @brief Stream every token through a queue, as the lexer and parser do
+template <typename Queue>
+void run_queue(bench::Report &report, const char *name,
+               const std::vector<Token> &tokens) {
+    Queue queue;
+    const double rate = bench::items_per_second(
+        [&]() {
+            for (const Token &token : tokens)
+                queue.enqueue(token);
+            while (!queue.is_empty())
+                (void)queue.dequeue();
+        },
+        tokens.size());
+    report.add(name, {{"tokens_per_second", rate}});
+}
+
+/// @brief Push every token onto a stack and pop it again, as the shunting-yard
+/// operator stack does with deeply nested input
+template <typename Stack>
+void run_stack(bench::Report &report, const char *name,
+               const std::vector<Token> &tokens) {
+    Stack stack;
+    const double rate = bench::items_per_second(
+        [&]() {
+            for (const Token &token : tokens)
+                stack.push(token);
+            while (!stack.is_empty())
+                (void)stack.pop();
+        },
+        tokens.size());
+    report.add(name, {{"tokens_per_second", rate}});
+}
+} // namespace
+
+int main() {
+    std::string expression;
+    for (int i = 0; i < 100000; i++)
+        expression += "(" + std::to_string(i) + " + 2.5) * 3 > 1 && ";
+    expression += "true";
+
+    expression_evaluator::TokenQueue token_queue;
+    lexer::tokenize(expression, token_queue);
+
+    std::vector<Token> tokens;
+    while (!token_queue.is_empty())
+        tokens.push_back(token_queue.dequeue());
+
+    bench::Report report("containers");
+    run_queue<Queue<Token, HeapAllocator>>(report, "queue/heap_nodes", tokens);
+    run_queue<Queue<Token, PoolAllocator>>(report, "queue/pooled_nodes",
+                                           tokens);
+    run_queue<RingQueue<Token>>(report, "queue/ring_buffer", tokens);
+    run_stack<Stack<Token, HeapAllocator>>(report, "stack/heap_nodes", tokens);
+    run_stack<Stack<Token, PoolAllocator>>(report, "stack/pooled_nodes",
+                                           tokens);
+    run_stack<ArrayStack<Token>>(report, "stack/array", tokens);
+
+    report.print();
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <expression_evaluator/compiler.hpp>
+#include <expression_evaluator/expression_set.hpp>
+
+#include "bench_util.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+namespace compiler = expression_evaluator::compiler;
+namespace expression_set = expression_evaluator::expression_set;
+using expression_evaluator::evaluator::Value;
+
+constexpr size_t RULES = 400;
+
+/// @brief Threshold rules over a few shared subterms, as in rule sets that
+/// compare the same ratios against different constants
+std::vector<std::string> make_rules() {
+    const char *const templates[] = {
+        "(price - cost) / cost > 0.",
+        "(price - cost) / cost < -0.",
+        "price * qty + cost * qty > ",
+        "qty > 10 && (price - cost) / cost >= 0.",
+        "(price * qty - budget) / budget <= 0."};
+
+    std::vector<std::string> rules;
+    rules.reserve(RULES);
+    for (size_t rule = 0; rule < RULES; rule++)
+        rules.push_back(templates[rule % std::size(templates)] +
+                        std::to_string(rule / std::size(templates) + 1));
+
+    return rules;
+}
+} // namespace
+
+int main() {
+    bench::Report report("expression_set");
+
+    const std::vector<std::string> rules = make_rules();
+    std::vector<compiler::CompiledExpression> programs;
+    expression_set::ExpressionSet set;
+    for (const std::string &rule : rules) {
+        programs.push_back(compiler::optimize(compiler::compile(rule)));
+        (void)set.add(programs.back());
+    }
+
+    // The row, by name
+    const auto value_of = [](std::string_view name) {
+        return name == "price" ? Value{12.5}
+               : name == "cost" ? Value{10.0}
+               : name == "qty"  ? Value{40}
+                                : Value{400};
+    };
+
+    std::vector<std::vector<Value>> program_bindings;
+    for (const compiler::CompiledExpression &program : programs) {
+        std::vector<Value> bindings;
+        for (const std::string &name : program.get_variables())
+            bindings.push_back(value_of(name));
+        program_bindings.push_back(std::move(bindings));
+    }
+
+    std::vector<Value> set_bindings;
+    for (const std::string &name : set.get_variables())
+        set_bindings.push_back(value_of(name));
+
+    size_t matches = 0;
+    const double separate_rate = bench::items_per_second(
+        [&]() {
+            for (size_t rule = 0; rule < programs.size(); rule++)
+                matches += programs[rule]
+                               .evaluate(program_bindings[rule])
+                               .as_bool();
+        },
+        programs.size());
+    report.add("separate_programs", {{"rules_per_second", separate_rate}});
+
+    std::vector<Value> results(set.size(), Value{0.0});
+    const double shared_rate = bench::items_per_second(
+        [&]() {
+            set.evaluate(set_bindings, results);
+            for (const Value &result : results)
+                matches += result.as_bool();
+        },
+        set.size());
+    report.add("expression_set",
+               {{"rules_per_second", shared_rate},
+                {"instructions", static_cast<double>(
+                                     set.get_instruction_count())},
+                {"nodes", static_cast<double>(set.get_node_count())}});
+
+    report.print();
+    return matches == 0;
+}
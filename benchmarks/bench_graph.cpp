@@ -0,0 +1,92 @@
+#include <expression_evaluator/graph.hpp>
+
+#include "bench_util.hpp"
+
+#include <string>
+
+namespace {
+namespace graph = expression_evaluator::graph;
+using expression_evaluator::evaluator::Value;
+
+constexpr size_t INPUTS = 100;
+constexpr size_t FORMULAS = 10000;
+
+std::string input_name(size_t input) { return "in" + std::to_string(input); }
+
+std::string formula_name(size_t formula) {
+    return "f" + std::to_string(formula);
+}
+
+/// @brief Formula i reads one input and formula i - INPUTS, so each input
+/// has a chain of FORMULAS / INPUTS formulas depending on it
+void define_sheet(graph::ExpressionGraph &sheet) {
+    for (size_t input = 0; input < INPUTS; input++)
+        sheet.set_input(input_name(input), Value{1.0});
+
+    for (size_t formula = 0; formula < FORMULAS; formula++) {
+        std::string text = input_name(formula % INPUTS) + " * 0.5 + ";
+        text += formula < INPUTS ? "1" : formula_name(formula - INPUTS);
+        sheet.define(formula_name(formula), text);
+    }
+}
+} // namespace
+
+int main() {
+    bench::Report report("graph");
+
+    graph::ExpressionGraph sheet;
+    define_sheet(sheet);
+    (void)sheet.recalculate();
+
+    // Changing one input re-evaluates only its chain
+    double value = 0.0;
+    size_t input = 0;
+    size_t evaluations = sheet.get_evaluation_count();
+    size_t updates = 0;
+    const std::string last = formula_name(FORMULAS - 1);
+    const double update_rate = bench::items_per_second(
+        [&]() {
+            sheet.set_input(input_name(input), Value{value});
+            value += 1.0;
+            input = (input + 1) % INPUTS;
+            (void)sheet.try_get(last);
+            updates++;
+        },
+        1);
+    report.add("update_one_input",
+               {{"updates_per_second", update_rate},
+                {"formulas_per_update",
+                 static_cast<double>(sheet.get_evaluation_count() -
+                                     evaluations) /
+                     static_cast<double>(updates)}});
+
+    // What every update costs without dependency tracking
+    evaluations = sheet.get_evaluation_count();
+    updates = 0;
+    const double full_rate = bench::items_per_second(
+        [&]() {
+            for (size_t changed = 0; changed < INPUTS; changed++)
+                sheet.set_input(input_name(changed), Value{value});
+            value += 1.0;
+            (void)sheet.recalculate();
+            updates++;
+        },
+        1);
+    report.add("update_all_inputs",
+               {{"updates_per_second", full_rate},
+                {"formulas_per_update",
+                 static_cast<double>(sheet.get_evaluation_count() -
+                                     evaluations) /
+                     static_cast<double>(updates)}});
+
+    const double define_rate = bench::items_per_second(
+        [&]() {
+            graph::ExpressionGraph defined;
+            define_sheet(defined);
+        },
+        FORMULAS);
+    report.add("define", {{"formulas_per_second", define_rate}});
+
+    report.print();
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <expression_evaluator/compiler.hpp>
+#include <expression_evaluator/evaluator.hpp>
+#include <expression_evaluator/lexer.hpp>
+#include <expression_evaluator/parser.hpp>
+#include <expression_evaluator/token.hpp>
+
+#include "bench_util.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+using expression_evaluator::TokenQueue;
+namespace compiler = expression_evaluator::compiler;
+namespace evaluator = expression_evaluator::evaluator;
+namespace lexer = expression_evaluator::lexer;
+namespace parser = expression_evaluator::parser;
+
+// Evaluations per timed call, so that short programs are not dominated by
+// reading the clock
+constexpr size_t REPETITIONS = 1000;
+
+struct Program {
+    std::string name;
+    std::string expression;
+};
+
+std::vector<Program> make_programs() {
+    std::vector<Program> programs;
+
+    programs.push_back(Program{"short_arithmetic", "1 + 2 * 3 - 8 / 4 ^ 2"});
+
+    std::string sum = "0";
+    const char *const operators[] = {" + ", " * ", " - ", " / "};
+    for (int term = 1; term < 256; term++)
+        sum += std::string(operators[term % 4]) + std::to_string(term % 7 + 1);
+    programs.push_back(Program{"long_arithmetic", sum});
+
+    std::string chain;
+    for (int term = 0; term < 128; term++) {
+        if (term != 0)
+            chain += term % 3 == 0 ? " || " : " && ";
+        chain += std::to_string(term) + (term % 2 == 0 ? " < " : " >= ") +
+                 std::to_string(term + term % 5);
+    }
+    programs.push_back(Program{"logical_chain", chain});
+
+    // Decided by its left operand, so compiled programs skip the sum
+    programs.push_back(Program{"short_circuit", "1 > 2 && " + sum + " > 0"});
+
+    // Counting-style powers: small integer bases and exponents
+    std::string powers = "0";
+    for (int term = 1; term < 64; term++)
+        powers += " + " + std::to_string(term % 13 + 1) + " ^ " +
+                  std::to_string(term % 9 + 1);
+    programs.push_back(Program{"integer_powers", powers});
+
+    // Deeper than the interpreter's inline stack
+    std::string nested = "1";
+    for (int depth = 0; depth < 128; depth++)
+        nested = std::to_string(depth % 9 + 1) + " - (" + nested + ")";
+    programs.push_back(Program{"deep_nesting", nested});
+
+    return programs;
+}
+} // namespace
+
+int main() {
+    bench::Report report("interpreter");
+
+    for (const Program &program : make_programs()) {
+        const compiler::CompiledExpression compiled =
+            compiler::compile(program.expression);
+        const size_t operations = compiled.get_code().size() * REPETITIONS;
+
+        // The token-walking evaluator consumes its queues, so they are
+        // rebuilt (untimed) before every call
+        std::vector<TokenQueue> queues(REPETITIONS);
+        const double token_rate = bench::items_per_second(
+            [&]() {
+                for (TokenQueue &postfix : queues) {
+                    TokenQueue infix;
+                    lexer::tokenize(program.expression, infix);
+                    parser::to_postfix(infix, postfix);
+                }
+            },
+            [&]() {
+                for (TokenQueue &postfix : queues)
+                    (void)evaluator::evaluate_expression(postfix);
+            },
+            operations);
+        report.add(program.name + "/evaluate_expression",
+                   {{"operations_per_second", token_rate},
+                    {"nanoseconds_per_operation", 1e9 / token_rate}});
+
+        const double compiled_rate = bench::items_per_second(
+            [&]() {
+                for (size_t i = 0; i < REPETITIONS; i++)
+                    (void)compiled.evaluate();
+            },
+            operations);
+        report.add(program.name + "/compiled",
+                   {{"operations_per_second", compiled_rate},
+                    {"nanoseconds_per_operation", 1e9 / compiled_rate}});
+    }
+
+    report.print();
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <expression_evaluator/lexer.hpp>
+
+#include "bench_util.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+namespace lexer = expression_evaluator::lexer;
+
+// Each expression is about this large, like a generated rule file
+constexpr size_t EXPRESSION_BYTES = 4 << 20;
+
+struct Input {
+    std::string name;
+    std::string expression;
+};
+
+std::vector<Input> make_inputs() {
+    std::vector<Input> inputs;
+
+    // Indented terms with long names and literals, as code generators write
+    std::string generated;
+    for (size_t term = 0; generated.size() < EXPRESSION_BYTES; term++) {
+        generated += term == 0 ? "        " : "\n        + ";
+        generated += "quarterly_revenue_region_" + std::to_string(term % 97) +
+                     " * " + std::to_string(1234567 + term * 7919) + "." +
+                     std::to_string(250000 + term % 1000);
+    }
+    inputs.push_back(Input{"generated", std::move(generated)});
+
+    // Short tokens and single spaces, where runs end within a few bytes
+    std::string compact = "0";
+    while (compact.size() < EXPRESSION_BYTES)
+        compact += " + " + std::to_string(compact.size() % 10) + " * x";
+    inputs.push_back(Input{"compact", std::move(compact)});
+
+    return inputs;
+}
+
+/// @brief Returns the number of tokens in the expression
+size_t count_tokens(const std::string &expression, lexer::Scanner scanner) {
+    lexer::Lexer lexer(expression, scanner);
+    size_t tokens = 0;
+    while (lexer.try_next().value())
+        tokens++;
+
+    return tokens;
+}
+} // namespace
+
+int main() {
+    bench::Report report("lexer");
+
+    const std::pair<lexer::Scanner, const char *> scanners[] = {
+        {lexer::Scanner::SCALAR, "scalar"},
+        {lexer::Scanner::SSE2, "sse2"},
+        {lexer::Scanner::AVX2, "avx2"}};
+
+    for (const Input &input : make_inputs()) {
+        const size_t tokens =
+            count_tokens(input.expression, lexer::Scanner::SCALAR);
+        double scalar_rate = 0.0;
+
+        for (const auto &[scanner, name] : scanners) {
+            if (!lexer::is_supported(scanner))
+                continue;
+
+            const double byte_rate = bench::items_per_second(
+                [&]() { (void)count_tokens(input.expression, scanner); },
+                input.expression.size());
+            if (scanner == lexer::Scanner::SCALAR)
+                scalar_rate = byte_rate;
+
+            const double bytes_per_token =
+                static_cast<double>(input.expression.size()) /
+                static_cast<double>(tokens);
+            report.add(input.name + "/" + name,
+                       {{"megabytes_per_second", byte_rate / 1e6},
+                        {"tokens_per_second", byte_rate / bytes_per_token},
+                        {"speedup", byte_rate / scalar_rate}});
+        }
+    }
+
+    report.print();
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include <expression_evaluator/cache.hpp>
+#include <expression_evaluator/evaluator.hpp>
+#include <expression_evaluator/lexer.hpp>
+#include <expression_evaluator/parser.hpp>
+#include <expression_evaluator/token.hpp>
+
+#include "bench_util.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+using expression_evaluator::TokenQueue;
+namespace cache = expression_evaluator::cache;
+namespace evaluator = expression_evaluator::evaluator;
+namespace lexer = expression_evaluator::lexer;
+namespace parser = expression_evaluator::parser;
+
+struct Corpus {
+    std::string name;
+    std::vector<std::string> expressions;
+};
+
+std::vector<Corpus> make_corpora() {
+    std::vector<Corpus> corpora;
+
+    corpora.push_back(Corpus{"short_arithmetic",
+                             {"1 + 2 * 3", "(4 - 1) / 3 ^ 2", "-5 + 10 * 2 - 3",
+                              "7 * (8 - 2) / 4", "2 ^ 8 - 1",
+                              "100 / 4 / 5 + 6"}});
+
+    std::string nested = "1";
+    for (int depth = 0; depth < 256; depth++)
+        nested = "(" + nested + (depth % 2 == 0 ? " + " : " - ") +
+                 std::to_string(depth % 9 + 1) + ")";
+    corpora.push_back(Corpus{"nested_parentheses", {nested}});
+
+    std::string chain;
+    for (int term = 0; term < 256; term++) {
+        if (term != 0)
+            chain += term % 3 == 0 ? " || " : " && ";
+        chain += std::to_string(term) + (term % 2 == 0 ? " < " : " >= ") +
+                 std::to_string(term + term % 5);
+    }
+    corpora.push_back(Corpus{"logical_chains", {chain}});
+
+    std::string floats = "3.14159265";
+    const char *const operators[] = {" * ", " + ", " - ", " / "};
+    for (int literal = 1; literal < 256; literal++)
+        floats += std::string(operators[literal % 4]) +
+                  std::to_string(literal) + "." +
+                  std::to_string(literal * 7919 % 100000 + 1);
+    corpora.push_back(Corpus{"float_literals", {floats}});
+
+    return corpora;
+}
+
+/// @brief Tokenize every expression of a corpus into its own queue
+void tokenize_all(const Corpus &corpus, std::vector<TokenQueue> &queues) {
+    for (size_t i = 0; i < corpus.expressions.size(); i++)
+        lexer::tokenize(corpus.expressions[i], queues[i]);
+}
+
+/// @brief Tokenize and convert every expression of a corpus to postfix
+void to_postfix_all(const Corpus &corpus, std::vector<TokenQueue> &queues) {
+    for (size_t i = 0; i < corpus.expressions.size(); i++) {
+        TokenQueue infix;
+        lexer::tokenize(corpus.expressions[i], infix);
+        parser::to_postfix(infix, queues[i]);
+    }
+}
+} // namespace
+
+int main() {
+    bench::Report report("pipeline");
+
+    for (const Corpus &corpus : make_corpora()) {
+        const size_t expression_count = corpus.expressions.size();
+        std::vector<TokenQueue> queues(expression_count);
+
+        size_t token_count = 0;
+        tokenize_all(corpus, queues);
+        for (const TokenQueue &queue : queues)
+            token_count += queue.size();
+
+        const double tokenize_rate = bench::items_per_second(
+            [&]() {
+                for (const std::string &expression : corpus.expressions) {
+                    TokenQueue infix;
+                    lexer::tokenize(expression, infix);
+                }
+            },
+            token_count);
+        report.add(corpus.name + "/tokenize",
+                   {{"tokens_per_second", tokenize_rate}});
+
+        // queues already holds the infix tokens from counting above
+        const double parse_rate = bench::items_per_second(
+            [&]() {
+                if (queues.front().is_empty())
+                    tokenize_all(corpus, queues);
+            },
+            [&]() {
+                for (TokenQueue &infix : queues) {
+                    TokenQueue postfix;
+                    parser::to_postfix(infix, postfix);
+                }
+            },
+            token_count);
+        report.add(corpus.name + "/to_postfix",
+                   {{"tokens_per_second", parse_rate}});
+
+        const double evaluate_rate = bench::items_per_second(
+            [&]() { to_postfix_all(corpus, queues); },
+            [&]() {
+                for (TokenQueue &postfix : queues)
+                    (void)evaluator::evaluate_expression(postfix);
+            },
+            expression_count);
+        report.add(corpus.name + "/evaluate_expression",
+                   {{"evaluations_per_second", evaluate_rate}});
+
+        const double end_to_end_rate = bench::items_per_second(
+            [&]() {
+                for (const std::string &expression : corpus.expressions) {
+                    TokenQueue infix;
+                    lexer::tokenize(expression, infix);
+                    TokenQueue postfix;
+                    parser::to_postfix(infix, postfix);
+                    (void)evaluator::evaluate_expression(postfix);
+                }
+            },
+            expression_count);
+        report.add(corpus.name + "/end_to_end",
+                   {{"evaluations_per_second", end_to_end_rate},
+                    {"tokens_per_second",
+                     end_to_end_rate * static_cast<double>(token_count) /
+                         static_cast<double>(expression_count)}});
+
+        const double streaming_rate = bench::items_per_second(
+            [&]() {
+                for (const std::string &expression : corpus.expressions)
+                    (void)evaluator::evaluate(expression);
+            },
+            expression_count);
+        report.add(corpus.name + "/streaming",
+                   {{"evaluations_per_second", streaming_rate},
+                    {"tokens_per_second",
+                     streaming_rate * static_cast<double>(token_count) /
+                         static_cast<double>(expression_count)}});
+
+        // Every expression is cached after the first call, so this measures
+        // hash lookups and compiled evaluation
+        cache::ExpressionCache expressions;
+        const double cached_rate = bench::items_per_second(
+            [&]() {
+                for (const std::string &expression : corpus.expressions)
+                    (void)expressions.get(expression).evaluate();
+            },
+            expression_count);
+        const cache::CacheStats &stats = expressions.get_stats();
+        report.add(corpus.name + "/cached",
+                   {{"evaluations_per_second", cached_rate},
+                    {"hit_rate", static_cast<double>(stats.hits) /
+                                     static_cast<double>(stats.hits +
+                                                         stats.misses)}});
+    }
+
+    report.print();
+    return 0;
+}
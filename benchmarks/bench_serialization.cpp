@@ -0,0 +1,85 @@
+#include <expression_evaluator/compiler.hpp>
+#include <expression_evaluator/serialization.hpp>
+
+#include "bench_util.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+namespace compiler = expression_evaluator::compiler;
+namespace serialization = expression_evaluator::serialization;
+using expression_evaluator::evaluator::Value;
+
+constexpr size_t RULES = 20000;
+
+/// @brief Rule expressions of a few variables and constants each, all
+/// different
+std::vector<std::string> make_rules() {
+    const char *const templates[] = {
+        "price * qty > limit + ", "(a - b) / (a + b) >= 0.", "x ^ 2 + y ^ 2 < ",
+        "score > 50 && age >= 18 || vip == ", "-(t - 273.15) * 1.8 + "};
+
+    std::vector<std::string> rules;
+    rules.reserve(RULES);
+    for (size_t rule = 0; rule < RULES; rule++) {
+        std::string text = templates[rule % std::size(templates)];
+        text += rule % 5 == 3 ? (rule % 2 == 0 ? "true" : "false")
+                              : std::to_string(rule);
+        rules.push_back(std::move(text));
+    }
+
+    return rules;
+}
+} // namespace
+
+int main() {
+    bench::Report report("serialization");
+
+    const std::vector<std::string> rules = make_rules();
+    std::vector<compiler::CompiledExpression> programs;
+    for (const std::string &rule : rules)
+        programs.push_back(compiler::optimize(compiler::compile(rule)));
+    const std::string image = serialization::serialize(programs);
+
+    // What a service does at startup without an image
+    const double compile_rate = bench::items_per_second(
+        [&]() {
+            std::vector<compiler::CompiledExpression> compiled;
+            compiled.reserve(rules.size());
+            for (const std::string &rule : rules)
+                compiled.push_back(compiler::optimize(compiler::compile(rule)));
+        },
+        rules.size());
+    report.add("compile_and_optimize", {{"programs_per_second", compile_rate}});
+
+    const double serialize_rate = bench::items_per_second(
+        [&]() { (void)serialization::serialize(programs); }, programs.size());
+    report.add("serialize", {{"programs_per_second", serialize_rate}});
+
+    // Opening checks the checksum; views are then read from the records
+    size_t code_size = 0;
+    const double load_rate = bench::items_per_second(
+        [&]() {
+            const serialization::ProgramImage loaded(image);
+            for (size_t index = 0; index < loaded.size(); index++)
+                code_size += loaded[index].get_code().size();
+        },
+        programs.size());
+    report.add("load", {{"programs_per_second", load_rate},
+                        {"image_bytes", static_cast<double>(image.size())}});
+
+    const serialization::ProgramImage loaded(image);
+    const Value row[] = {Value{3.5}, Value{2}, Value{9}, Value{true}};
+    const double evaluate_rate = bench::items_per_second(
+        [&]() {
+            for (size_t index = 0; index < loaded.size(); index++)
+                (void)loaded[index].try_evaluate(row);
+        },
+        loaded.size());
+    report.add("evaluate_in_place",
+               {{"evaluations_per_second", evaluate_rate}});
+
+    report.print();
+    return code_size == 0;
+}
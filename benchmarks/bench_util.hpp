@@ -0,0 +1,104 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bench {
+using clock = std::chrono::steady_clock;
+
+/// @brief Run fn repeatedly for at least min_seconds
+/// @param items_per_call The number of items (rows, tokens, ...) fn processes
+/// per call
+/// @return Items processed per second
+template <typename Fn>
+double items_per_second(Fn &&fn, size_t items_per_call,
+                        double min_seconds = 0.5) {
+    size_t iterations = 0;
+    const clock::time_point start = clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        fn();
+        iterations++;
+        elapsed = clock::now() - start;
+    } while (elapsed.count() < min_seconds);
+
+    return static_cast<double>(iterations * items_per_call) / elapsed.count();
+}
+
+/// @brief Like items_per_second, but calls setup (untimed) before every call
+/// to fn, for stages that consume their input
+template <typename Setup, typename Fn>
+double items_per_second(Setup &&setup, Fn &&fn, size_t items_per_call,
+                        double min_seconds = 0.5) {
+    size_t iterations = 0;
+    std::chrono::duration<double> elapsed{};
+    do {
+        setup();
+        const clock::time_point start = clock::now();
+        fn();
+        elapsed += clock::now() - start;
+        iterations++;
+    } while (elapsed.count() < min_seconds);
+
+    return static_cast<double>(iterations * items_per_call) / elapsed.count();
+}
+
+/// @brief Collects named measurements and prints them as a JSON document, so
+/// results can be tracked over time
+class Report {
+  private:
+    struct Result {
+        std::string name;
+        std::vector<std::pair<std::string, double>> metrics;
+    };
+
+    std::string suite;
+    std::vector<Result> results;
+
+    static void print_string(std::string_view text) {
+        std::putchar('"');
+        for (const char c : text) {
+            if (c == '"' || c == '\\')
+                std::putchar('\\');
+            std::putchar(c);
+        }
+        std::putchar('"');
+    }
+
+  public:
+    explicit Report(std::string suite) : suite(std::move(suite)) {}
+
+    /// @brief Record one or more metrics under a result name
+    void add(std::string name,
+             std::initializer_list<std::pair<std::string, double>> metrics) {
+        results.push_back(Result{std::move(name), metrics});
+    }
+
+    /// @brief Print the report to stdout
+    void print() const {
+        std::printf("{\n  \"suite\": ");
+        print_string(suite);
+        std::printf(",\n  \"results\": [");
+
+        for (size_t i = 0; i < results.size(); i++) {
+            std::printf(i == 0 ? "\n    {\"name\": " : ",\n    {\"name\": ");
+            print_string(results[i].name);
+
+            for (const auto &[metric, value] : results[i].metrics) {
+                std::printf(", ");
+                print_string(metric);
+                std::printf(": %.6g", value);
+            }
+            std::printf("}");
+        }
+
+        std::printf("\n  ]\n}\n");
+    }
+};
+} // namespace bench
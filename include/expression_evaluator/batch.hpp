@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <expression_evaluator/compiler.hpp>
+#include <expression_evaluator/evaluator.hpp>
+#include <expression_evaluator/mapped_file.hpp>
+
+namespace expression_evaluator::batch {
+/// @brief Accumulates output in a large buffer and hands it to a stream in
+/// big chunks, instead of flushing after every line
+class BufferedWriter {
+  private:
+    std::FILE *stream;
+    std::unique_ptr<char[]> buffer;
+    size_t capacity;
+    size_t used = 0;
+
+  public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 20;
+
+    explicit BufferedWriter(std::FILE *stream,
+                            size_t capacity = DEFAULT_CAPACITY)
+        : stream(stream), buffer(new char[capacity]), capacity(capacity) {}
+    ~BufferedWriter();
+
+    BufferedWriter(const BufferedWriter &) = delete;
+    BufferedWriter &operator=(const BufferedWriter &) = delete;
+
+    /// @throws std::runtime_error if the stream cannot be written
+    void write(std::string_view text);
+    /// @brief Write a value formatted as by Value::to_string, without
+    /// allocating
+    /// @throws std::runtime_error if the stream cannot be written
+    void write(const evaluator::Value &value);
+    /// @brief Write the buffered output to the stream
+    /// @throws std::runtime_error if the stream cannot be written
+    void flush();
+};
+
+/// @brief Evaluate the compiled program of a line as the command line tool
+/// does in both its modes. Compiled programs skip the right operand of && and
+/// || when the left one decides the result. Nothing binds variables, so a
+/// program with any reports the first one as unbound
+/// @param program The program compiled from the line, optimized or not
+/// @param line The line, which must outlive the error's message() call
+/// @return The value, or the error
+[[nodiscard]] Result<evaluator::Value>
+try_evaluate_program(const compiler::CompiledExpression &program,
+                     std::string_view line);
+
+/// @brief Compile one line and evaluate it as by try_evaluate_program, so
+/// lexing and parsing errors are reported before evaluation errors
+/// @param line The expression, which must outlive the error's message() call
+/// @return The value, or the error
+[[nodiscard]] Result<evaluator::Value>
+try_evaluate_line(std::string_view line);
+
+struct BatchStats {
+    size_t lines = 0;
+    size_t errors = 0;
+};
+
+/// @brief Evaluate every newline-delimited expression of the input, as by
+/// try_evaluate_line, and write one line per input line: the result,
+/// "error: " followed by the error message, or nothing for a blank line. A
+/// trailing "\r" is ignored, and a final line without a newline is still
+/// evaluated
+/// @param input The expressions, e.g. from a MappedFile
+/// @param output Receives the results
+/// @return The number of lines and of lines that failed
+/// @throws std::runtime_error if the output cannot be written
+BatchStats evaluate_lines(std::string_view input, BufferedWriter &output);
+
+/// @brief Evaluate every newline-delimited expression of the input on
+/// several threads, writing the same output as the single-threaded overload.
+/// The input is split into chunks of lines; each thread starts with an equal
+/// share of them and steals from the others when it runs out. Results are
+/// written in input order as soon as all earlier chunks are done
+/// @param input The expressions, e.g. from a MappedFile
+/// @param output Receives the results
+/// @param thread_count The number of threads, or 0 for one per hardware
+/// thread
+/// @return The number of lines and of lines that failed
+/// @throws std::runtime_error if the output cannot be written
+BatchStats evaluate_lines(std::string_view input, BufferedWriter &output,
+                          unsigned thread_count);
+} // namespace expression_evaluator::batch
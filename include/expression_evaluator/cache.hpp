@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <expression_evaluator/compiler.hpp>
+#include <expression_evaluator/structures/text_hash.hpp>
+
+namespace expression_evaluator::cache {
+struct CacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+};
+
+/// @brief A bounded map from expression text to its compiled and optimized
+/// program, so that repeated expressions skip lexing and parsing. When the
+/// estimated memory use exceeds the budget, the least recently used programs
+/// are evicted. Not thread-safe
+class ExpressionCache {
+  private:
+    struct Entry {
+        std::string text;
+        compiler::CompiledExpression program;
+        size_t size;
+    };
+
+    // Most recently used first. Entries never move in memory, so the index
+    // can key on views of their text
+    std::list<Entry> entries;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator,
+                       structures::TextHash>
+        index;
+    size_t memory_budget;
+    size_t memory_usage = 0;
+    CacheStats stats;
+
+    /// @brief Evict least recently used entries, except the most recent one,
+    /// until memory use is within budget
+    void evict();
+
+  public:
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = 4 * 1024 * 1024;
+
+    /// @param memory_budget The approximate number of bytes the cached
+    /// programs, their text and bookkeeping may occupy
+    explicit ExpressionCache(size_t memory_budget = DEFAULT_MEMORY_BUDGET)
+        : memory_budget(memory_budget) {}
+
+    /// @brief Return the program for an expression, compiling and caching it
+    /// if it is not cached yet. Variables are assigned slots in order of first
+    /// appearance, as with compiler::compile
+    /// @param expression The expression string
+    /// @return The program, which stays valid until the next call that
+    /// modifies the cache
+    /// @throws std::runtime_error on invalid expressions, which are not cached
+    [[nodiscard]] const compiler::CompiledExpression &
+    get(std::string_view expression);
+
+    /// @brief Remove every cached program. Counters are kept
+    void clear() noexcept;
+
+    /// @brief Returns the number of cached programs
+    [[nodiscard]] size_t size() const noexcept { return entries.size(); }
+
+    /// @brief Returns the estimated number of bytes used by cached programs
+    [[nodiscard]] size_t get_memory_usage() const noexcept {
+        return memory_usage;
+    }
+
+    [[nodiscard]] size_t get_memory_budget() const noexcept {
+        return memory_budget;
+    }
+
+    /// @brief Change the memory budget, evicting programs if it shrank
+    void set_memory_budget(size_t budget);
+
+    [[nodiscard]] const CacheStats &get_stats() const noexcept {
+        return stats;
+    }
+};
+} // namespace expression_evaluator::cache
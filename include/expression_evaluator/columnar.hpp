@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+#include <expression_evaluator/compiler.hpp>
+
+namespace expression_evaluator::columnar {
+enum class ColumnType {
+    NUMBER,
+    BOOLEAN,
+};
+
+enum class KernelSet {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+/// @brief Returns the fastest kernel set supported by the running CPU
+[[nodiscard]] KernelSet best_kernel_set() noexcept;
+
+/// @brief Returns whether the running CPU supports a kernel set
+[[nodiscard]] bool is_supported(KernelSet kernels) noexcept;
+
+/// @brief Evaluate a compiled program over many rows of numeric variables.
+/// Each operator runs as a vectorized kernel over a block of rows instead of
+/// being dispatched once per row
+/// @param program The compiled program to evaluate
+/// @param columns One column per variable slot, each holding row_count values
+/// @param row_count The number of rows to evaluate
+/// @param output Receives row_count results; booleans are written as 1.0 or
+/// 0.0. Its contents are unspecified if an exception is thrown
+/// @param kernels The kernel set to use, which must be supported
+/// @return The type of the values written to output
+/// @throws std::runtime_error on type errors, division by zero in any row, or
+/// if fewer columns than variables are supplied
+ColumnType evaluate(const compiler::CompiledExpression &program,
+                    std::span<const double *const> columns, size_t row_count,
+                    double *output, KernelSet kernels = best_kernel_set());
+} // namespace expression_evaluator::columnar
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <expression_evaluator/evaluator.hpp>
+
+namespace expression_evaluator::compiler {
+enum class OpCode : std::uint8_t {
+    // Push constants[operand] onto the value stack
+    PUSH_CONSTANT,
+    // Push bindings[operand] onto the value stack
+    LOAD_VARIABLE,
+
+    // Unary operators
+    NEGATE,
+
+    // Type checks, which leave the value on the stack unchanged
+    REQUIRE_NUMBER,
+    REQUIRE_BOOL,
+
+    // Arithmetic operators
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    POWER,
+
+    // Comparison operators
+    EQUAL,
+    NOT_EQUAL,
+    GREATER,
+    LESS,
+    GREATER_EQUAL,
+    LESS_EQUAL,
+
+    // Logical operators, which evaluate both operands
+    AND,
+    OR,
+
+    // Short-circuit jumps, which compile() emits in place of AND and OR. The
+    // value on top of the stack must be a boolean. If it decides the result
+    // (false for JUMP_IF_FALSE, true for JUMP_IF_TRUE), it is kept and the
+    // next operand instructions are skipped; otherwise it is popped
+    JUMP_IF_FALSE,
+    JUMP_IF_TRUE,
+
+    // Push a copy of the value on top of the stack. Nothing emits it any
+    // more, but version 2 images may contain it
+    DUPLICATE,
+};
+
+struct Instruction {
+    OpCode op;
+    std::uint32_t operand;
+};
+
+struct OptimizationStats {
+    size_t instructions_before = 0;
+    size_t instructions_after = 0;
+    // Operators whose result was computed at compile time
+    size_t folded_operations = 0;
+    // Operators removed by identities such as x * 1 or true && p
+    size_t simplified_operations = 0;
+
+    [[nodiscard]] size_t removed_instructions() const noexcept {
+        return instructions_before - instructions_after;
+    }
+};
+
+class CompiledExpression;
+
+/// @brief Apply a unary operator (or type check) to a value
+/// @throws std::runtime_error on type errors
+[[nodiscard]] evaluator::Value apply_unary(OpCode op,
+                                           const evaluator::Value &operand);
+
+/// @brief Apply a binary operator to two values
+/// @throws std::runtime_error on type errors or division by zero
+[[nodiscard]] evaluator::Value apply_binary(OpCode op,
+                                            const evaluator::Value &left,
+                                            const evaluator::Value &right);
+
+/// @brief Apply an operator (or type check) to values without throwing, with
+/// the checks and errors of a program. Meant for diagnosing failed checks, as
+/// it runs the operator as a small program
+/// @param op Any opcode but PUSH_CONSTANT, LOAD_VARIABLE and the jumps
+/// @param left The operand of a unary operator, or the left operand
+/// @param right The right operand of a binary operator; ignored otherwise
+/// @return The result, or the error
+[[nodiscard]] Result<evaluator::Value> try_apply(OpCode op,
+                                                 const evaluator::Value &left,
+                                                 const evaluator::Value &right);
+
+/// @brief Replace each AND and OR with a short-circuit jump before its right
+/// operand and a REQUIRE_BOOL after it, so that the right operand is only
+/// evaluated when the left one does not decide the result
+/// @param code Straight-line code, as built by compile()
+/// @return The code with jumps
+[[nodiscard]] std::vector<Instruction>
+insert_jumps(std::span<const Instruction> code);
+
+/// @brief Undo insert_jumps(), turning each jump and the REQUIRE_BOOL that
+/// ends its right operand back into AND or OR. The result evaluates both
+/// operands, which suits passes that work on straight-line code
+/// @param code Code with jumps, as produced by insert_jumps()
+/// @return The straight-line code
+[[nodiscard]] std::vector<Instruction>
+remove_jumps(std::span<const Instruction> code);
+
+/// @brief Fold constant subexpressions and apply identities that preserve
+/// results and errors, such as x * 1 -> x, --x -> x and true && p -> p. When
+/// the type of the remaining operand is not known at compile time, a type
+/// check is kept in its place. Constant subexpressions that raise an error are
+/// left in place so that the error is raised on evaluation as before
+/// @param program The program to optimize
+/// @param stats Receives instruction counts before and after optimization
+/// @return The optimized program
+[[nodiscard]] CompiledExpression optimize(const CompiledExpression &program,
+                                          OptimizationStats &stats);
+
+/// @brief Fold constant subexpressions and apply identities, see above
+[[nodiscard]] CompiledExpression optimize(const CompiledExpression &program);
+
+/// @brief Run a program held outside a CompiledExpression, such as one in a
+/// serialized image, without throwing. See CompiledExpression::try_evaluate
+/// @param code The instructions, as produced by compile() or optimize()
+/// @param constants The constant pool referenced by PUSH_CONSTANT
+/// @param variable_count The number of variable slots of the program
+/// @param max_stack_depth The program's get_max_stack_depth()
+/// @param bindings Values of the variables, indexed by slot
+/// @return The resulting value of the program, or the error
+[[nodiscard]] Result<evaluator::Value>
+try_execute(std::span<const Instruction> code,
+            std::span<const evaluator::Value> constants, size_t variable_count,
+            size_t max_stack_depth, std::span<const evaluator::Value> bindings);
+
+/// @brief An immutable, copyable program produced from an expression string.
+/// Lexing and parsing happen once in compile(); evaluate() only walks the flat
+/// instruction array.
+///
+/// Unlike evaluator::evaluate, programs short-circuit && and ||: the left
+/// operand must be a boolean, and the right operand is only evaluated (and
+/// then must be a boolean) when the left one does not decide the result. So
+/// false && 1 / 0 is false, while true && 1 / 0 raises the division error.
+class CompiledExpression {
+  private:
+    std::vector<Instruction> code;
+    std::vector<evaluator::Value> constants;
+    std::vector<std::string> variables;
+    size_t max_stack_depth;
+
+    CompiledExpression(std::vector<Instruction> code,
+                       std::vector<evaluator::Value> constants,
+                       std::vector<std::string> variables,
+                       size_t max_stack_depth)
+        : code(std::move(code)), constants(std::move(constants)),
+          variables(std::move(variables)), max_stack_depth(max_stack_depth) {}
+
+    friend Result<CompiledExpression> try_compile(std::string_view expression);
+    friend Result<CompiledExpression>
+    try_compile(std::string_view expression,
+                std::span<const std::string_view> variable_names);
+    friend CompiledExpression optimize(const CompiledExpression &program,
+                                       OptimizationStats &stats);
+
+  public:
+    /// @brief Evaluate the program without throwing on type errors, division
+    /// by zero or missing bindings. Errors have no source offset
+    /// @param bindings Values of the variables, indexed by slot (see
+    /// get_variables())
+    /// @return The resulting value of the expression, or the error
+    [[nodiscard]] Result<evaluator::Value>
+    try_evaluate(std::span<const evaluator::Value> bindings = {}) const {
+        return try_execute(code, constants, variables.size(), max_stack_depth,
+                           bindings);
+    }
+
+    /// @brief Evaluate the program
+    /// @param bindings Values of the variables, indexed by slot (see
+    /// get_variables())
+    /// @return The resulting value of the expression
+    /// @throws std::runtime_error on type errors, division by zero, or if
+    /// fewer bindings than variables are supplied
+    [[nodiscard]] evaluator::Value
+    evaluate(std::span<const evaluator::Value> bindings = {}) const {
+        return try_evaluate(bindings).value();
+    }
+
+    /// @brief Returns the variable names, where a name's index is its slot
+    [[nodiscard]] const std::vector<std::string> &
+    get_variables() const noexcept {
+        return variables;
+    }
+
+    /// @brief Returns the slot of a variable, if the program has one by that
+    /// name
+    [[nodiscard]] std::optional<size_t>
+    find_variable(std::string_view name) const noexcept {
+        for (size_t slot = 0; slot < variables.size(); slot++)
+            if (variables[slot] == name)
+                return slot;
+
+        return std::nullopt;
+    }
+
+    /// @brief Returns the instructions of the program in execution order
+    [[nodiscard]] const std::vector<Instruction> &get_code() const noexcept {
+        return code;
+    }
+
+    /// @brief Returns the constant pool referenced by PUSH_CONSTANT
+    [[nodiscard]] const std::vector<evaluator::Value> &
+    get_constants() const noexcept {
+        return constants;
+    }
+
+    /// @brief Returns the largest number of values live on the stack at once,
+    /// also when both operands of every && and || are evaluated
+    [[nodiscard]] size_t get_max_stack_depth() const noexcept {
+        return max_stack_depth;
+    }
+};
+
+/// @brief Tokenize, parse and flatten an expression into a reusable program,
+/// without throwing on invalid expressions. Variables are assigned slots in
+/// order of first appearance. See compile()
+/// @param expression The expression string to compile, which must outlive
+/// the error's message() call
+/// @return The compiled program, or the first error with its source offset
+[[nodiscard]] Result<CompiledExpression>
+try_compile(std::string_view expression);
+
+/// @brief Tokenize, parse and flatten an expression into a reusable program
+/// with a fixed variable layout, without throwing on invalid expressions or
+/// unknown variables. See compile()
+/// @param expression The expression string to compile, which must outlive
+/// the error's message() call
+/// @param variable_names The allowed variable names; a name's index is its
+/// slot. An empty list allows no variables
+/// @return The compiled program, or the first error with its source offset
+[[nodiscard]] Result<CompiledExpression>
+try_compile(std::string_view expression,
+            std::span<const std::string_view> variable_names);
+
+/// @brief Tokenize, parse and flatten an expression into a reusable program.
+/// Variables are assigned slots in order of first appearance
+/// @param expression The expression string to compile
+/// @return The compiled program
+/// @throws std::runtime_error on invalid expressions
+[[nodiscard]] CompiledExpression compile(std::string_view expression);
+
+/// @brief Tokenize, parse and flatten an expression into a reusable program,
+/// using a fixed variable layout so that many programs can share one binding
+/// array
+/// @param expression The expression string to compile
+/// @param variable_names The allowed variable names; a name's index is its
+/// slot. An empty list allows no variables
+/// @return The compiled program
+/// @throws std::runtime_error on invalid expressions or unknown variables
+[[nodiscard]] CompiledExpression
+compile(std::string_view expression,
+        std::span<const std::string_view> variable_names);
+} // namespace expression_evaluator::compiler
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace expression_evaluator {
+
+enum class ErrorCode : std::uint8_t {
+    // Type errors
+    EXPECTED_NUMBER,
+    EXPECTED_BOOLEAN,
+    TYPE_MISMATCH,
+
+    // Math errors
+    DIVISION_BY_ZERO,
+
+    // Syntax errors
+    MISSING_OPERAND,
+    INSUFFICIENT_OPERANDS,
+    TOO_MANY_OPERANDS,
+    MISMATCHED_PARENTHESES,
+
+    // Lexical errors
+    MULTIPLE_DECIMAL_POINTS,
+    INVALID_NUMBER,
+    UNEXPECTED_CHARACTER,
+    EXPRESSION_TOO_LONG,
+
+    // Variable errors
+    UNBOUND_VARIABLE,
+    UNKNOWN_VARIABLE,
+    MISSING_BINDINGS,
+    CIRCULAR_REFERENCE,
+
+    UNKNOWN_OPERATOR,
+};
+
+/// @brief Describes why an expression could not be evaluated, without
+/// formatting a message until one is requested. Errors about a literal, a
+/// character or a variable name refer to the expression string, like
+/// IDENTIFIER tokens, so it must outlive them for message() to be called
+class Error {
+  public:
+    static constexpr std::uint32_t NO_SOURCE_OFFSET = UINT32_MAX;
+
+  private:
+    ErrorCode code;
+    std::uint32_t source_offset;
+    // The offending literal, character or variable name
+    std::string_view text;
+    // The operand of a type error, with booleans as 1 or 0
+    double operand = 0.0;
+    // The numbers of bindings a program expected and was supplied
+    size_t expected = 0;
+    size_t supplied = 0;
+
+  public:
+    /// @param code What went wrong
+    /// @param source_offset Where in the expression, if known
+    explicit Error(ErrorCode code,
+                   std::uint32_t source_offset = NO_SOURCE_OFFSET) noexcept
+        : code(code), source_offset(source_offset) {}
+
+    /// @brief A boolean used where a number is required
+    [[nodiscard]] static Error
+    expected_number(bool operand,
+                    std::uint32_t source_offset = NO_SOURCE_OFFSET) noexcept;
+    /// @brief A number used where a boolean is required
+    [[nodiscard]] static Error
+    expected_boolean(double operand,
+                     std::uint32_t source_offset = NO_SOURCE_OFFSET) noexcept;
+    /// @brief An error about part of the expression: an INVALID_NUMBER
+    /// literal, an UNEXPECTED_CHARACTER, or an UNBOUND_VARIABLE,
+    /// UNKNOWN_VARIABLE or CIRCULAR_REFERENCE name
+    [[nodiscard]] static Error
+    with_text(ErrorCode code, std::string_view text,
+              std::uint32_t source_offset = NO_SOURCE_OFFSET) noexcept;
+    /// @brief Fewer bindings supplied than a program has variables
+    [[nodiscard]] static Error missing_bindings(size_t expected,
+                                                size_t supplied) noexcept;
+
+    [[nodiscard]] ErrorCode get_code() const noexcept { return code; }
+
+    /// @brief Returns the offset in the expression string of the token or
+    /// character at fault, if known. Compiled programs do not keep source
+    /// positions, so errors raised while evaluating them have none
+    [[nodiscard]] std::optional<std::uint32_t>
+    get_source_offset() const noexcept {
+        if (source_offset == NO_SOURCE_OFFSET)
+            return std::nullopt;
+
+        return source_offset;
+    }
+
+    /// @brief Format the message that the throwing API reports for this error
+    [[nodiscard]] std::string message() const;
+
+    /// @brief Throw the error as the throwing API does
+    /// @throws std::runtime_error with message()
+    [[noreturn]] void raise() const;
+};
+
+/// @brief Either a value or the error that prevented computing it
+template <typename T> class [[nodiscard]] Result {
+  private:
+    std::variant<T, Error> contents;
+
+  public:
+    template <typename U = T>
+        requires std::is_constructible_v<T, U &&>
+    Result(U &&value)
+        : contents(std::in_place_index<0>, std::forward<U>(value)) {}
+    Result(Error error) noexcept : contents(std::in_place_index<1>, error) {}
+
+    [[nodiscard]] bool has_value() const noexcept {
+        return contents.index() == 0;
+    }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    /// @brief Returns the value
+    /// @throws std::runtime_error with the error's message if there is none
+    [[nodiscard]] T &value() & {
+        if (!has_value())
+            get_error().raise();
+        return *std::get_if<0>(&contents);
+    }
+    [[nodiscard]] const T &value() const & {
+        if (!has_value())
+            get_error().raise();
+        return *std::get_if<0>(&contents);
+    }
+    [[nodiscard]] T value() && {
+        if (!has_value())
+            get_error().raise();
+        return std::move(*std::get_if<0>(&contents));
+    }
+
+    /// @brief Returns the error; there must be one
+    [[nodiscard]] const Error &get_error() const noexcept {
+        return *std::get_if<1>(&contents);
+    }
+};
+
+/// @brief The outcome of an operation that produces no value
+template <> class [[nodiscard]] Result<void> {
+  private:
+    std::optional<Error> error;
+
+  public:
+    Result() noexcept = default;
+    Result(Error error) noexcept : error(error) {}
+
+    [[nodiscard]] bool has_value() const noexcept { return !error; }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    /// @throws std::runtime_error with the error's message if there is one
+    void value() const {
+        if (error)
+            error->raise();
+    }
+
+    /// @brief Returns the error; there must be one
+    [[nodiscard]] const Error &get_error() const noexcept { return *error; }
+};
+} // namespace expression_evaluator
@@ -1,30 +1,48 @@
 #pragma once
 
-#include <expression_evaluator/structures/queue.hpp>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <expression_evaluator/error.hpp>
 #include <expression_evaluator/token.hpp>
 #include <iomanip>
 #include <limits>
+#include <optional>
 #include <sstream>
 #include <string>
-#include <variant>
+#include <string_view>
+#include <type_traits>
 
 namespace expression_evaluator::evaluator {
-struct Value {
-    std::variant<double, bool> data;
+/// @brief A number or a boolean in 8 bytes. Booleans are stored as the two
+/// largest 64-bit patterns, which are NaNs with an all-ones payload that
+/// arithmetic never produces, so every type check is a single comparison. A
+/// number that happens to use one of them is replaced by another NaN
+class Value {
+  private:
+    static constexpr std::uint64_t FALSE_BITS = ~std::uint64_t{1};
+    static constexpr std::uint64_t TRUE_BITS = ~std::uint64_t{0};
+    static constexpr std::uint64_t NEGATIVE_QUIET_NAN = 0xfff8'0000'0000'0000;
 
-    explicit Value(double d) : data(d) {}
-    explicit Value(bool b) : data(b) {}
-    explicit Value(int i) : data(static_cast<double>(i)) {}
+    std::uint64_t bits;
 
-    [[nodiscard]] bool is_number() const noexcept {
-        return std::holds_alternative<double>(data);
-    }
-    [[nodiscard]] bool is_bool() const noexcept {
-        return std::holds_alternative<bool>(data);
+  public:
+    explicit Value(double d) noexcept : bits(std::bit_cast<std::uint64_t>(d)) {
+        if (is_bool()) [[unlikely]]
+            bits = NEGATIVE_QUIET_NAN;
     }
+    explicit Value(bool b) noexcept : bits(b ? TRUE_BITS : FALSE_BITS) {}
+    explicit Value(int i) noexcept : Value(static_cast<double>(i)) {}
+
+    [[nodiscard]] bool is_number() const noexcept { return bits < FALSE_BITS; }
+    [[nodiscard]] bool is_bool() const noexcept { return bits >= FALSE_BITS; }
 
-    [[nodiscard]] double as_number() const { return std::get<double>(data); }
-    [[nodiscard]] bool as_bool() const { return std::get<bool>(data); }
+    /// @brief Returns the number; the value must be a number
+    [[nodiscard]] double as_number() const noexcept {
+        return std::bit_cast<double>(bits);
+    }
+    /// @brief Returns the boolean; the value must be a boolean
+    [[nodiscard]] bool as_bool() const noexcept { return bits == TRUE_BITS; }
 
     [[nodiscard]] std::string to_string() const {
         if (is_number()) {
@@ -37,11 +55,208 @@ struct Value {
     }
 };
 
+static_assert(sizeof(Value) == 8 && std::is_trivially_copyable_v<Value>);
+
+/// @brief Ensure the operand is a number and return it, or throw an error
+/// @throws std::runtime_error if the value is not a number
+[[nodiscard]] double require_number(const Value &val);
+
+/// @brief Ensure the operand is a boolean and return it, or throw an error
+/// @throws std::runtime_error if the value is not a boolean
+[[nodiscard]] bool require_bool(const Value &val);
+
+/// @brief Raise a number to a power, as `^` does. Integer bases with
+/// non-negative integer exponents are raised by repeated squaring while every
+/// product is an integer below 2^53, and so exact; the rest use std::pow
+[[nodiscard]] constexpr double power(double base, double exponent) noexcept {
+    // Doubles hold every integer of smaller magnitude exactly
+    constexpr double EXACT_LIMIT = 9007199254740992.0;
+    if (exponent >= 0.0 && exponent < EXACT_LIMIT && base > -EXACT_LIMIT &&
+        base < EXACT_LIMIT) {
+        auto remaining = static_cast<std::uint64_t>(exponent);
+        const auto integer_base = static_cast<std::int64_t>(base);
+        if (static_cast<double>(remaining) == exponent &&
+            static_cast<double>(integer_base) == base) {
+            double result = 1.0;
+            double square = base;
+            while (true) {
+                if ((remaining & 1) != 0) {
+                    result *= square;
+                    if (!(result > -EXACT_LIMIT && result < EXACT_LIMIT))
+                        break;
+                }
+
+                remaining >>= 1;
+                if (remaining == 0)
+                    return result;
+
+                square *= square;
+                if (!(square < EXACT_LIMIT))
+                    break;
+            }
+        }
+    }
+
+    return std::pow(base, exponent);
+}
+
+/// @brief Apply +, -, * or ^ to two integers in int64, as every evaluation
+/// path does for integer literals and the results computed from them, so that
+/// they stay exact beyond 2^53. Overflow is checked, and raising to a
+/// non-negative power uses repeated squaring
+/// @return The exact result, or std::nullopt when it needs a double: on
+/// overflow, for a negative exponent, for a zero that would be -0 as a
+/// double, and for other operators. The operator is then applied to the
+/// operands converted to double
+[[nodiscard]] constexpr std::optional<std::int64_t>
+apply_integers(TokenType op, std::int64_t left, std::int64_t right) noexcept {
+    std::int64_t result = 0;
+    switch (op) {
+    case TokenType::PLUS:
+        if (__builtin_add_overflow(left, right, &result))
+            return std::nullopt;
+        return result;
+    case TokenType::MINUS:
+        if (__builtin_sub_overflow(left, right, &result))
+            return std::nullopt;
+        return result;
+    case TokenType::MULTIPLY:
+        if (__builtin_mul_overflow(left, right, &result) ||
+            (result == 0 && (left < 0) != (right < 0)))
+            return std::nullopt;
+        return result;
+    case TokenType::POWER: {
+        if (right < 0)
+            return std::nullopt;
+
+        auto remaining = static_cast<std::uint64_t>(right);
+        std::int64_t square = left;
+        result = 1;
+        while (true) {
+            if ((remaining & 1) != 0 &&
+                __builtin_mul_overflow(result, square, &result))
+                return std::nullopt;
+
+            remaining >>= 1;
+            if (remaining == 0)
+                return result;
+            if (__builtin_mul_overflow(square, square, &square))
+                return std::nullopt;
+        }
+    }
+    default:
+        return std::nullopt;
+    }
+}
+
+/// @brief Negate an integer in int64, see apply_integers()
+/// @return The exact result, or std::nullopt for 0, whose negation is -0,
+/// and for the smallest int64, whose negation overflows
+[[nodiscard]] constexpr std::optional<std::int64_t>
+negate_integer(std::int64_t operand) noexcept {
+    if (operand == 0 || operand == std::numeric_limits<std::int64_t>::min())
+        return std::nullopt;
+    return -operand;
+}
+
+/// @brief Compare two integers exactly with ==, !=, >, <, >= or <=, as every
+/// evaluation path does for integer literals and the results computed from
+/// them
+/// @return The result, or std::nullopt for other operators
+[[nodiscard]] constexpr std::optional<bool>
+compare_integers(TokenType op, std::int64_t left, std::int64_t right) noexcept {
+    switch (op) {
+    case TokenType::EQUAL:
+        return left == right;
+    case TokenType::NOT_EQUAL:
+        return left != right;
+    case TokenType::GREATER:
+        return left > right;
+    case TokenType::LESS:
+        return left < right;
+    case TokenType::GREATER_EQUAL:
+        return left >= right;
+    case TokenType::LESS_EQUAL:
+        return left <= right;
+    default:
+        return std::nullopt;
+    }
+}
+
+/// @brief Evaluates tokens in postfix order as they arrive, one at a time
+class StackEvaluator {
+  private:
+    struct Operand {
+        Value value;
+        // The exact value of an integer literal or a result computed from
+        // them, see apply_integers(); value holds it converted to double
+        std::optional<std::int64_t> integer;
+
+        Operand(Value value,
+                std::optional<std::int64_t> integer = std::nullopt) noexcept
+            : value(value), integer(integer) {}
+    };
+
+    structures::DefaultStack<Operand> value_stack;
+    // The expression the tokens come from, if known, so that errors about
+    // variables can report where their name is
+    std::string_view expression;
+
+  public:
+    StackEvaluator() = default;
+    /// @param expression The expression that the tokens are lexed from
+    explicit StackEvaluator(std::string_view expression)
+        : expression(expression) {}
+
+    /// @brief Push an operand, or apply an operator to the values on the stack
+    /// @return The error of an invalid operand or operator, if any, at the
+    /// token's offset
+    [[nodiscard]] Result<void> try_apply(const Token &token);
+
+    /// @brief Push an operand, or apply an operator to the values on the stack
+    /// @throws std::runtime_error on tokens representing invalid mathematical
+    /// expressions
+    void apply(const Token &token) { try_apply(token).value(); }
+
+    /// @brief Return the value of the complete expression, or an error if the
+    /// stack does not hold exactly one value
+    [[nodiscard]] Result<Value> try_result();
+
+    /// @brief Return the value of the complete expression
+    /// @throws std::runtime_error if the stack does not hold exactly one value
+    [[nodiscard]] Value result() { return try_result().value(); }
+};
+
+/// @brief Evaluate a postfix expression represented as a queue of tokens,
+/// without throwing on invalid expressions
+/// @param postfix_queue Queue containing tokens in postfix order
+/// @return The resulting value of the evaluated expression, or the first error
+[[nodiscard]] Result<Value> try_evaluate_expression(TokenQueue &postfix_queue);
+
 /// @brief Evaluate a postfix expression represented as a queue of tokens
 /// @param postfix_queue Queue containing tokens in postfix order
 /// @return The resulting value of the evaluated expression
 /// @throws std::runtime_error on tokens representing invalid mathematical
 /// expressions
-[[nodiscard]] Value
-evaluate_expression(structures::Queue<Token> &postfix_queue);
+[[nodiscard]] Value evaluate_expression(TokenQueue &postfix_queue);
+
+/// @brief Tokenize, convert and evaluate an expression in one streaming pass,
+/// without throwing on invalid expressions. Errors carry the offset of the
+/// token at fault, and their message is only formatted on request. The pass
+/// stops at the first error it meets, so an evaluation error hides lexing and
+/// parsing errors later in the expression: 1 / 0 + $ is a division by zero.
+/// batch::try_evaluate_line reports those first
+/// @param expression The expression string to evaluate, which must outlive
+/// the error's message() call
+/// @return The resulting value of the evaluated expression, or the first error
+[[nodiscard]] Result<Value> try_evaluate(std::string_view expression);
+
+/// @brief Tokenize, convert and evaluate an expression in one streaming pass.
+/// Tokens flow from the lexer through the shunting-yard stage straight onto
+/// the value stack, so no token queues are materialized and memory use is
+/// proportional to nesting depth rather than expression length
+/// @param expression The expression string to evaluate
+/// @return The resulting value of the evaluated expression
+/// @throws std::runtime_error on invalid expressions
+[[nodiscard]] Value evaluate(std::string_view expression);
 } // namespace expression_evaluator::evaluator
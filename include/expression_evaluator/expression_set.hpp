@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <expression_evaluator/compiler.hpp>
+
+namespace expression_evaluator::expression_set {
+/// @brief Many expressions compiled into one shared graph of operations, so
+/// that subexpressions they have in common, such as (a - b) / b compared
+/// against different thresholds, are computed once per evaluation. Variables
+/// are shared by name, and each evaluation produces the results of every
+/// expression in one pass.
+///
+/// Results and errors are those of each expression's CompiledExpression:
+/// the right operand of && and || is computed when it is shared, but its
+/// errors only count when the left operand does not decide the result
+class ExpressionSet {
+  private:
+    /// @brief An operation; operands are the indices of earlier nodes. For
+    /// PUSH_CONSTANT and LOAD_VARIABLE, left is a constant index or a slot.
+    /// Unary operations have right equal to left
+    struct Node {
+        compiler::OpCode op;
+        std::uint32_t left;
+        std::uint32_t right;
+
+        bool operator==(const Node &) const = default;
+    };
+
+    struct NodeHash {
+        [[nodiscard]] size_t operator()(const Node &node) const noexcept {
+            return std::hash<std::uint64_t>{}(
+                (std::uint64_t{node.left} << 32 | node.right) * 31 +
+                static_cast<std::uint64_t>(node.op));
+        }
+    };
+
+    // In evaluation order, with every node after its operands
+    std::vector<Node> nodes;
+    std::unordered_map<Node, std::uint32_t, NodeHash> index;
+    std::vector<evaluator::Value> constants;
+    std::unordered_map<std::uint64_t, std::uint32_t> constant_index;
+    std::vector<std::string> variables;
+    std::unordered_map<std::string, std::uint32_t> variable_index;
+    // The node computing each expression's result
+    std::vector<std::uint32_t> roots;
+    size_t instruction_count = 0;
+
+    /// @brief Returns the node for an operation, adding it if it is new
+    std::uint32_t intern(const Node &node);
+
+    /// @brief Compute every node for one set of bindings, into the calling
+    /// thread's scratch space
+    void run(std::span<const evaluator::Value> bindings) const;
+
+  public:
+    /// @brief Add an expression, sharing the operations it has in common
+    /// with those already added
+    /// @param expression The expression string, compiled and optimized here
+    /// @return The expression's index among the results
+    /// @throws std::runtime_error on invalid expressions, which are not added
+    size_t add(std::string_view expression);
+
+    /// @brief Add a compiled program, see add(std::string_view). Its
+    /// variables are bound by name to the set's slots
+    /// @throws std::runtime_error if the set would need 2^32 or more nodes
+    size_t add(const compiler::CompiledExpression &program);
+
+    /// @brief Evaluate every expression without throwing
+    /// @param bindings Values of the variables, indexed by the set's slots
+    /// (see get_variables())
+    /// @param results Receives the result or error of each expression, in
+    /// the order they were added; must hold size() entries
+    void try_evaluate(std::span<const evaluator::Value> bindings,
+                      std::span<Result<evaluator::Value>> results) const;
+
+    /// @brief Evaluate every expression
+    /// @param bindings Values of the variables, indexed by the set's slots
+    /// @param results Receives the value of each expression, in the order
+    /// they were added; must hold size() values
+    /// @throws std::runtime_error with the error of the first expression
+    /// that fails, or if fewer bindings than variables are supplied
+    void evaluate(std::span<const evaluator::Value> bindings,
+                  std::span<evaluator::Value> results) const;
+
+    /// @brief Returns the number of expressions
+    [[nodiscard]] size_t size() const noexcept { return roots.size(); }
+
+    /// @brief Returns the variable names, where a name's index is its slot
+    [[nodiscard]] const std::vector<std::string> &
+    get_variables() const noexcept {
+        return variables;
+    }
+
+    /// @brief Returns the slot of a variable, if an expression reads it
+    [[nodiscard]] std::optional<size_t>
+    find_variable(std::string_view name) const;
+
+    /// @brief Returns the number of distinct operations computed per
+    /// evaluation, including constants and variable loads
+    [[nodiscard]] size_t get_node_count() const noexcept {
+        return nodes.size();
+    }
+
+    /// @brief Returns the number of operations the expressions would compute
+    /// if evaluated separately, without && and || skipping any
+    [[nodiscard]] size_t get_instruction_count() const noexcept {
+        return instruction_count;
+    }
+};
+} // namespace expression_evaluator::expression_set
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <expression_evaluator/compiler.hpp>
+#include <expression_evaluator/structures/text_hash.hpp>
+
+namespace expression_evaluator::graph {
+/// @brief Named inputs and formulas over them, like the cells of a
+/// spreadsheet. Each formula is compiled once when defined, and the graph
+/// records which names it reads. Changing an input marks only the formulas
+/// that depend on it, directly or not, as dirty, and the next read
+/// re-evaluates just those, each after everything it reads.
+///
+/// Names that are read but neither set nor defined evaluate to an
+/// UNBOUND_VARIABLE error, and formulas reading a name that has an error
+/// take on that error. Not thread-safe
+class ExpressionGraph {
+  private:
+    struct Node {
+        std::string name;
+        // Only formulas have a program
+        std::optional<compiler::CompiledExpression> program;
+        // The node bound to each variable slot of the program
+        std::vector<size_t> dependencies;
+        // The formulas that read this node
+        std::vector<size_t> dependents;
+        Result<evaluator::Value> result;
+        // Greater than the level of every dependency, so evaluating dirty
+        // nodes by level respects the dependency order
+        size_t level = 0;
+        // The last search that reached this node, see creates_cycle()
+        size_t visit = 0;
+        bool dirty = false;
+        bool defined = false;
+
+        explicit Node(std::string_view name);
+    };
+
+    // Nodes never move in memory, so the index can key on views of their
+    // names, and errors can refer to them
+    std::deque<Node> nodes;
+    std::unordered_map<std::string_view, size_t, structures::TextHash> index;
+    std::vector<size_t> dirty;
+    std::vector<evaluator::Value> bindings;
+    size_t searches = 0;
+    size_t evaluations = 0;
+
+    /// @brief Returns the node of a name, adding an undefined one if needed
+    size_t intern(std::string_view name);
+
+    /// @brief Remove the edges from a node to its dependencies
+    void detach(size_t id);
+
+    /// @brief Whether a formula at id reading the given nodes would make it
+    /// depend on itself
+    bool creates_cycle(size_t id, const std::vector<size_t> &dependencies);
+
+    /// @brief Raise the levels of the nodes that depend on id, after its
+    /// level changed
+    void raise_levels(size_t id);
+
+    /// @brief Mark a node and everything that depends on it dirty
+    void mark_dirty(size_t id);
+
+    /// @brief Evaluate a formula from the results of its dependencies
+    void evaluate(Node &node);
+
+  public:
+    ExpressionGraph() = default;
+    ExpressionGraph(const ExpressionGraph &) = delete;
+    ExpressionGraph &operator=(const ExpressionGraph &) = delete;
+
+    /// @brief Make a name an input with a value, replacing any formula it
+    /// had. Setting the value it already has changes nothing
+    void set_input(std::string_view name, evaluator::Value value);
+
+    /// @brief Define a name as a formula, replacing any input or formula it
+    /// had, without throwing. The graph is unchanged on errors
+    /// @param name The name, which other formulas read as a variable
+    /// @param expression The formula, which must outlive the error's
+    /// message() call
+    /// @return Nothing, or the compile error (with its source offset), or a
+    /// CIRCULAR_REFERENCE error naming the formula if it would depend on
+    /// itself
+    [[nodiscard]] Result<void> try_define(std::string_view name,
+                                          std::string_view expression);
+
+    /// @brief Define a name as a formula, see try_define()
+    /// @throws std::runtime_error on invalid expressions or circular
+    /// references, leaving the graph unchanged
+    void define(std::string_view name, std::string_view expression) {
+        try_define(name, expression).value();
+    }
+
+    /// @brief Re-evaluate every dirty formula, in dependency order
+    /// @return The number of formulas evaluated
+    size_t recalculate();
+
+    /// @brief Returns the current value of a name, recalculating first if
+    /// any input changed, without throwing
+    /// @return The value, or the error of the formula or one it depends on,
+    /// or UNBOUND_VARIABLE for unknown names. Errors stay valid as long as
+    /// the graph and the expressions passed to it
+    [[nodiscard]] Result<evaluator::Value> try_get(std::string_view name);
+
+    /// @brief Returns the current value of a name, see try_get()
+    /// @throws std::runtime_error if it has an error or is unknown
+    [[nodiscard]] evaluator::Value get(std::string_view name) {
+        return try_get(name).value();
+    }
+
+    /// @brief Returns whether a name is an input or a formula
+    [[nodiscard]] bool contains(std::string_view name) const;
+
+    /// @brief Returns the names a formula reads, in slot order, or nothing
+    /// for inputs and unknown names
+    [[nodiscard]] std::vector<std::string_view>
+    get_dependencies(std::string_view name) const;
+
+    /// @brief Returns the number of formulas waiting to be re-evaluated
+    [[nodiscard]] size_t get_dirty_count() const noexcept {
+        return dirty.size();
+    }
+
+    /// @brief Returns the number of formula evaluations so far
+    [[nodiscard]] size_t get_evaluation_count() const noexcept {
+        return evaluations;
+    }
+};
+} // namespace expression_evaluator::graph
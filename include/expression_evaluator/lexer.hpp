@@ -1,14 +1,69 @@
 #pragma once
+#include <cstdint>
+#include <optional>
 #include <string_view>
 
-#include <expression_evaluator/structures/queue.hpp>
+#include <expression_evaluator/error.hpp>
 #include <expression_evaluator/token.hpp>
 
 namespace expression_evaluator::lexer {
+/// @brief How the lexer finds the end of a run of spaces, digits or identifier
+/// characters: one byte at a time, or 16 or 32 bytes at a time
+enum class Scanner {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+/// @brief Returns the fastest scanner supported by the running CPU
+[[nodiscard]] Scanner best_scanner() noexcept;
+
+/// @brief Returns whether the running CPU supports a scanner
+[[nodiscard]] bool is_supported(Scanner scanner) noexcept;
+
+/// @brief Produces the tokens of an expression string one at a time, in infix
+/// order
+class Lexer {
+  private:
+    std::string_view expression;
+    size_t current_position;
+    Scanner scanner;
+    // For detecting unary minus
+    bool last_was_operator_or_lparen;
+
+  public:
+    /// @param expression The expression string to tokenize, which must outlive
+    /// the lexer and any IDENTIFIER tokens it produces
+    /// @param scanner The scanner to use; all produce the same tokens, and
+    /// unsupported ones fall back to Scanner::SCALAR
+    explicit Lexer(std::string_view expression,
+                   Scanner scanner = best_scanner()) noexcept
+        : expression(expression), current_position(0),
+          scanner(is_supported(scanner) ? scanner : Scanner::SCALAR),
+          last_was_operator_or_lparen(true) {}
+
+    /// @brief Return the next token, or std::nullopt at the end of the input.
+    /// Expressions of 4 GiB or more are rejected, as token offsets are 32 bits
+    /// @return The token, or the error at the current position
+    [[nodiscard]] Result<std::optional<Token>> try_next();
+
+    /// @brief Return the next token, or std::nullopt at the end of the input
+    /// @throws std::runtime_error on invalid expressions
+    [[nodiscard]] std::optional<Token> next() { return try_next().value(); }
+};
+
+/// @brief Tokenize an expression string into a queue of tokens in infix order
+/// @param expression The expression string to tokenize
+/// @param output_queue Queue to store the resulting tokens. IDENTIFIER tokens
+/// refer to the expression string, which must outlive them
+/// @return The first error in the expression, if any
+[[nodiscard]] Result<void> try_tokenize(std::string_view expression,
+                                        TokenQueue &output_queue);
+
 /// @brief Tokenize an expression string into a queue of tokens in infix order
 /// @param expression The expression string to tokenize
-/// @param output_queue Queue to store the resulting tokens
+/// @param output_queue Queue to store the resulting tokens. IDENTIFIER tokens
+/// refer to the expression string, which must outlive them
 /// @throws std::runtime_error on invalid expressions
-void tokenize(std::string_view expression,
-              structures::Queue<Token> &output_queue);
+void tokenize(std::string_view expression, TokenQueue &output_queue);
 } // namespace expression_evaluator::lexer
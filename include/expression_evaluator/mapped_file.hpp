@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace expression_evaluator {
+/// @brief The read-only contents of a file, memory-mapped where the platform
+/// and file allow it, and read into memory otherwise (e.g. for pipes)
+class MappedFile {
+  private:
+    const char *mapping = nullptr;
+    size_t length = 0;
+    // Holds the contents when they could not be mapped
+    std::string contents;
+
+  public:
+    /// @brief Map or read a file
+    /// @param path The file to open, or "-" for standard input
+    /// @throws std::runtime_error if the file cannot be opened or read
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /// @brief Returns the contents, valid for the lifetime of the file
+    [[nodiscard]] std::string_view get_contents() const noexcept {
+        return mapping != nullptr ? std::string_view(mapping, length)
+                                  : std::string_view(contents);
+    }
+};
+} // namespace expression_evaluator
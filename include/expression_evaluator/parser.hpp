@@ -1,14 +1,174 @@
 #pragma once
 
-#include <expression_evaluator/structures/queue.hpp>
+#include <optional>
+#include <utility>
+
+#include <expression_evaluator/error.hpp>
 #include <expression_evaluator/token.hpp>
 
 namespace expression_evaluator::parser {
+/// @brief Returns the binding strength of an operator, higher binding tighter
+[[nodiscard]] constexpr int get_precedence(TokenType type) noexcept {
+    switch (type) {
+    case TokenType::OR:
+        return 1;
+    case TokenType::AND:
+        return 2;
+    case TokenType::EQUAL:
+    case TokenType::NOT_EQUAL:
+        return 3;
+    case TokenType::GREATER:
+    case TokenType::LESS:
+    case TokenType::GREATER_EQUAL:
+    case TokenType::LESS_EQUAL:
+        return 4;
+    case TokenType::PLUS:
+    case TokenType::MINUS:
+        return 5;
+    case TokenType::MULTIPLY:
+    case TokenType::DIVIDE:
+        return 6;
+    case TokenType::UNARY_MINUS:
+        return 7;
+    case TokenType::POWER:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+/// @brief Returns whether an operator groups from the right
+[[nodiscard]] constexpr bool is_right_associative(TokenType type) noexcept {
+    return type == TokenType::POWER || type == TokenType::UNARY_MINUS;
+}
+
+/// @brief Converts infix tokens to postfix notation incrementally using the
+/// shunting-yard algorithm. Infix tokens are pulled from the source only as
+/// needed to produce the next postfix token, so memory use is proportional to
+/// the operator stack depth rather than to the expression length
+/// @tparam Source Any type with a `Result<std::optional<Token>> try_next()`
+/// member that yields infix tokens, such as lexer::Lexer
+template <typename Source> class PostfixStream {
+  private:
+    Source &source;
+    structures::DefaultStack<Token> operator_stack;
+    // An operator or right parenthesis that still has to pop operators off
+    // the stack before it is consumed
+    std::optional<Token> pending;
+    bool source_exhausted;
+
+  public:
+    explicit PostfixStream(Source &source)
+        : source(source), source_exhausted(false) {}
+
+    /// @brief Return the next token in postfix order, or std::nullopt once
+    /// the whole expression has been converted
+    /// @return The token, or the error of the source or of mismatched
+    /// parentheses
+    [[nodiscard]] Result<std::optional<Token>> try_next() {
+        while (true) {
+            if (pending && pending->type == TokenType::RIGHT_PAREN) {
+                // If a left parenthesis is not found during popping, then
+                // there is a mismatched parenthesis in the input
+                if (operator_stack.is_empty())
+                    return Error(ErrorCode::MISMATCHED_PARENTHESES,
+                                 pending->get_source_offset());
+
+                Token top_operator = operator_stack.pop();
+                if (top_operator.type == TokenType::LEFT_PAREN) {
+                    pending.reset();
+                    continue;
+                }
+
+                return top_operator;
+            }
+
+            if (pending) {
+                if (!operator_stack.is_empty()) {
+                    const Token &top_operator = operator_stack.top();
+
+                    // Stop at left parenthesis since it delimits the current
+                    // subexpression
+                    if (top_operator.type != TokenType::LEFT_PAREN) {
+                        int top_operator_prec =
+                            get_precedence(top_operator.type);
+                        int current_token_precedence =
+                            get_precedence(pending->type);
+
+                        // An operator should be popped from the stack to the
+                        // output if it has greater (or equal if
+                        // left-associative) precedence than the current
+                        // operator.
+                        bool should_pop;
+                        if (is_right_associative(pending->type))
+                            should_pop =
+                                top_operator_prec > current_token_precedence;
+                        else
+                            should_pop =
+                                top_operator_prec >= current_token_precedence;
+
+                        if (should_pop)
+                            return operator_stack.pop();
+                    }
+                }
+
+                operator_stack.push(std::move(*pending));
+                pending.reset();
+                continue;
+            }
+
+            if (source_exhausted) {
+                // Emit any remaining operators on the stack. If any
+                // parentheses still remain in the stack, then there was a
+                // mismatched parenthesis in the input
+                if (operator_stack.is_empty())
+                    return std::nullopt;
+
+                Token top_operator = operator_stack.pop();
+                if (top_operator.type == TokenType::LEFT_PAREN ||
+                    top_operator.type == TokenType::RIGHT_PAREN)
+                    return Error(ErrorCode::MISMATCHED_PARENTHESES,
+                                 top_operator.get_source_offset());
+
+                return top_operator;
+            }
+
+            Result<std::optional<Token>> next_token = source.try_next();
+            if (!next_token)
+                return next_token.get_error();
+
+            std::optional<Token> &current_token = next_token.value();
+            if (!current_token)
+                source_exhausted = true;
+            else if (current_token->is_operand())
+                return current_token;
+            else if (current_token->type == TokenType::LEFT_PAREN)
+                operator_stack.push(std::move(*current_token));
+            else if (current_token->type == TokenType::RIGHT_PAREN ||
+                     current_token->is_operator())
+                pending = std::move(current_token);
+        }
+    }
+
+    /// @brief Return the next token in postfix order, or std::nullopt once
+    /// the whole expression has been converted
+    /// @throws std::runtime_error on mismatched parentheses, or if the source
+    /// fails
+    [[nodiscard]] std::optional<Token> next() { return try_next().value(); }
+};
+
+/// @brief Convert an infix expression (in a queue) to postfix notation using
+/// the shunting-yard algorithm
+/// @param infix_queue Queue containing tokens in infix order
+/// @param postfix_queue Queue to store tokens in postfix order
+/// @return The error of mismatched parentheses, if any
+[[nodiscard]] Result<void> try_to_postfix(TokenQueue &infix_queue,
+                                          TokenQueue &postfix_queue);
+
 /// @brief Convert an infix expression (in a queue) to postfix notation using
 /// the shunting-yard algorithm
 /// @param infix_queue Queue containing tokens in infix order
 /// @param postfix_queue Queue to store tokens in postfix order
 /// @throws std::runtime_error on mismatched parentheses
-void to_postfix(structures::Queue<Token> &infix_queue,
-                structures::Queue<Token> &postfix_queue);
+void to_postfix(TokenQueue &infix_queue, TokenQueue &postfix_queue);
 } // namespace expression_evaluator::parser
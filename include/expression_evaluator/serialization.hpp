@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <expression_evaluator/compiler.hpp>
+#include <expression_evaluator/mapped_file.hpp>
+
+namespace expression_evaluator::serialization {
+/// Images are little-endian, with every section aligned to 8 bytes:
+///
+///     ImageHeader
+///     ProgramRecord[program_count]
+///     for each program: its instructions, constants, VariableRecords and
+///     variable names
+///
+/// An instruction is 8 bytes: the OpCode, 3 zero bytes and the 32-bit
+/// operand. A constant is the 64-bit pattern of an evaluator::Value. Offsets
+/// are from the start of the image. Changing any of these, including the
+/// encoding of Value or the numbering of OpCode, requires a new version.
+/// Version 2 added DUPLICATE; version 1 images, which cannot contain it, are
+/// still read
+constexpr std::uint32_t FORMAT_VERSION = 2;
+constexpr std::uint32_t OLDEST_FORMAT_VERSION = 1;
+
+/// @brief Identifies a program image
+constexpr char MAGIC[8] = {'E', 'X', 'P', 'R', 'P', 'R', 'O', 'G'};
+
+struct ImageHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t program_count;
+    // The size of the whole image
+    std::uint64_t size;
+    // FNV-1a of the whole image, with this field as zero
+    std::uint64_t checksum;
+};
+
+struct ProgramRecord {
+    std::uint64_t code_offset;
+    std::uint64_t constants_offset;
+    std::uint64_t variables_offset;
+    std::uint32_t code_size;
+    std::uint32_t constant_count;
+    std::uint32_t variable_count;
+    std::uint32_t max_stack_depth;
+};
+
+struct VariableRecord {
+    std::uint64_t name_offset;
+    std::uint32_t name_length;
+    std::uint32_t reserved;
+};
+
+/// @brief Serialize compiled programs into one image, in the format above
+/// @param programs The programs, which keep their order
+/// @return The image
+/// @throws std::runtime_error if a program has 2^32 or more instructions,
+/// constants or variables
+[[nodiscard]] std::string
+serialize(std::span<const compiler::CompiledExpression> programs);
+
+/// @brief A program in an image, evaluated in place. Cheap to copy; valid
+/// while the image's bytes are
+class ProgramView {
+  private:
+    const char *image;
+    std::span<const compiler::Instruction> code;
+    std::span<const evaluator::Value> constants;
+    std::uint64_t variables_offset;
+    size_t variable_count;
+    size_t max_stack_depth;
+
+    ProgramView(const char *image, const ProgramRecord &record);
+
+    friend class ProgramImage;
+
+  public:
+    /// @brief Evaluate the program without throwing, see
+    /// CompiledExpression::try_evaluate
+    [[nodiscard]] Result<evaluator::Value>
+    try_evaluate(std::span<const evaluator::Value> bindings = {}) const {
+        return compiler::try_execute(code, constants, variable_count,
+                                     max_stack_depth, bindings);
+    }
+
+    /// @brief Evaluate the program, see CompiledExpression::evaluate
+    /// @throws std::runtime_error on type errors, division by zero, or if
+    /// fewer bindings than variables are supplied
+    [[nodiscard]] evaluator::Value
+    evaluate(std::span<const evaluator::Value> bindings = {}) const {
+        return try_evaluate(bindings).value();
+    }
+
+    [[nodiscard]] size_t get_variable_count() const noexcept {
+        return variable_count;
+    }
+
+    /// @brief Returns the name of the variable in a slot; slot must be less
+    /// than get_variable_count()
+    [[nodiscard]] std::string_view get_variable(size_t slot) const noexcept;
+
+    /// @brief Returns the slot of a variable, if the program has one by that
+    /// name
+    [[nodiscard]] std::optional<size_t>
+    find_variable(std::string_view name) const noexcept;
+
+    [[nodiscard]] std::span<const compiler::Instruction>
+    get_code() const noexcept {
+        return code;
+    }
+
+    [[nodiscard]] std::span<const evaluator::Value>
+    get_constants() const noexcept {
+        return constants;
+    }
+
+    [[nodiscard]] size_t get_max_stack_depth() const noexcept {
+        return max_stack_depth;
+    }
+};
+
+/// @brief The programs of an image, read in place: opening one checks the
+/// header, the checksum and, in one pass over each program, that it only
+/// reads within the image, its constants, its variables and a stack of its
+/// max_stack_depth. Nothing is copied. The checksum detects corruption, not
+/// tampering, so a crafted image can still compute wrong results
+class ProgramImage {
+  private:
+    const char *image;
+    size_t program_count;
+
+  public:
+    /// @param bytes The image, aligned to 8 bytes, which must outlive the
+    /// ProgramImage and its views
+    /// @throws std::runtime_error if the bytes are not an intact image of
+    /// OLDEST_FORMAT_VERSION to FORMAT_VERSION, if a program fails the
+    /// checks above, or on big-endian hosts
+    explicit ProgramImage(std::string_view bytes);
+
+    [[nodiscard]] size_t size() const noexcept { return program_count; }
+
+    /// @brief Returns a program; index must be less than size()
+    [[nodiscard]] ProgramView operator[](size_t index) const noexcept;
+};
+
+/// @brief A program image memory-mapped from a file
+class ProgramFile {
+  private:
+    MappedFile file;
+    ProgramImage image;
+
+  public:
+    /// @param path The file to map, or "-" for standard input
+    /// @throws std::runtime_error if the file cannot be read or is not an
+    /// intact image
+    explicit ProgramFile(const std::string &path)
+        : file(path), image(file.get_contents()) {}
+
+    [[nodiscard]] const ProgramImage &get_image() const noexcept {
+        return image;
+    }
+};
+} // namespace expression_evaluator::serialization
@@ -0,0 +1,695 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <expression_evaluator/error.hpp>
+#include <expression_evaluator/evaluator.hpp>
+#include <expression_evaluator/parser.hpp>
+#include <expression_evaluator/token.hpp>
+
+namespace expression_evaluator::static_expression {
+/// @brief The text of an expression as a template argument, such as the
+/// string literal of compile<"2 ^ 10 * x">()
+template <size_t N> struct ExpressionText {
+    // The characters and the terminating null of the literal
+    char characters[N]{};
+
+    consteval ExpressionText(const char (&text)[N]) {
+        for (size_t i = 0; i < N; i++)
+            characters[i] = text[i];
+    }
+
+    [[nodiscard]] static constexpr size_t size() noexcept { return N - 1; }
+
+    [[nodiscard]] constexpr std::string_view view() const noexcept {
+        return std::string_view(characters, N - 1);
+    }
+};
+
+/// @brief The static type of an expression or subexpression. Variables are
+/// numbers, so every type is known at compile time
+enum class Type : std::uint8_t {
+    NUMBER,
+    BOOLEAN,
+};
+
+namespace detail {
+/// @brief Deliberately not constexpr: reaching it while compiling an
+/// expression stops constant evaluation, and the diagnostic shows its
+/// arguments, the message and the offset of the offending token
+[[noreturn]] inline void invalid_expression(const char *message,
+                                            size_t source_offset) {
+    throw std::invalid_argument(std::string(message) + " at offset " +
+                                std::to_string(source_offset));
+}
+
+/// @brief Reject the expression with a message like the runtime one, and the
+/// offset of the offending token
+constexpr void require(bool condition, const char *message,
+                       size_t source_offset) {
+    if (!condition)
+        invalid_expression(message, source_offset);
+}
+
+/// @brief A fixed-width unsigned integer, wide enough to hold a number
+/// literal's digits exactly while converting it to the nearest double
+class WideInteger {
+  private:
+    static constexpr size_t LIMBS = 96;
+    // Least significant first
+    std::array<std::uint32_t, LIMBS> limbs{};
+
+  public:
+    // Leaves room for the 2^56 scaling of the quotient in parse_number()
+    static constexpr size_t MAX_DIGITS = 800;
+
+    constexpr explicit WideInteger(std::uint32_t value = 0) {
+        limbs[0] = value;
+    }
+
+    constexpr void multiply_add(std::uint32_t factor, std::uint32_t addend) {
+        std::uint64_t carry = addend;
+        for (std::uint32_t &limb : limbs) {
+            const std::uint64_t product = std::uint64_t{limb} * factor + carry;
+            limb = static_cast<std::uint32_t>(product);
+            carry = product >> 32;
+        }
+    }
+
+    constexpr void shift_left(size_t bits) {
+        const size_t whole = bits / 32;
+        const size_t part = bits % 32;
+        for (size_t index = LIMBS; index-- > 0;) {
+            std::uint64_t shifted = 0;
+            if (index >= whole)
+                shifted = std::uint64_t{limbs[index - whole]} << part;
+            if (index > whole && part != 0)
+                shifted |= limbs[index - whole - 1] >> (32 - part);
+            limbs[index] = static_cast<std::uint32_t>(shifted);
+        }
+    }
+
+    constexpr void shift_right_one() {
+        for (size_t index = 0; index < LIMBS; index++) {
+            limbs[index] >>= 1;
+            if (index + 1 < LIMBS)
+                limbs[index] |= limbs[index + 1] << 31;
+        }
+    }
+
+    /// @brief Subtract a value no greater than this one
+    constexpr void subtract(const WideInteger &other) {
+        std::uint64_t borrow = 0;
+        for (size_t index = 0; index < LIMBS; index++) {
+            const std::uint64_t difference =
+                std::uint64_t{limbs[index]} - other.limbs[index] - borrow;
+            limbs[index] = static_cast<std::uint32_t>(difference);
+            borrow = difference >> 63;
+        }
+    }
+
+    [[nodiscard]] constexpr size_t bit_width() const {
+        for (size_t index = LIMBS; index-- > 0;)
+            if (limbs[index] != 0)
+                return index * 32 + std::bit_width(limbs[index]);
+        return 0;
+    }
+
+    [[nodiscard]] constexpr bool is_zero() const { return bit_width() == 0; }
+
+    [[nodiscard]] constexpr bool
+    operator>=(const WideInteger &other) const {
+        for (size_t index = LIMBS; index-- > 0;)
+            if (limbs[index] != other.limbs[index])
+                return limbs[index] > other.limbs[index];
+        return true;
+    }
+};
+
+/// @brief Convert a literal of digits with at most one decimal point to the
+/// nearest double, as std::from_chars does at runtime. Literals outside the
+/// range of normal doubles are rejected
+constexpr double parse_number(std::string_view literal,
+                              size_t source_offset) {
+    WideInteger numerator;
+    WideInteger denominator(1);
+    size_t digits = 0;
+    bool in_fraction = false;
+    for (const char c : literal) {
+        if (c == '.') {
+            in_fraction = true;
+            continue;
+        }
+
+        require(++digits <= WideInteger::MAX_DIGITS, "Invalid number",
+                source_offset);
+        numerator.multiply_add(10, static_cast<std::uint32_t>(c - '0'));
+        if (in_fraction)
+            denominator.multiply_add(10, 0);
+    }
+
+    if (numerator.is_zero())
+        return 0.0;
+
+    // Scale the fraction so that its integer quotient has 54 or 55 bits: the
+    // 53 of a double's significand, and the rest to round with
+    const int scale = 54 - (static_cast<int>(numerator.bit_width()) -
+                            static_cast<int>(denominator.bit_width()));
+    if (scale > 0)
+        numerator.shift_left(static_cast<size_t>(scale));
+    else
+        denominator.shift_left(static_cast<size_t>(-scale));
+
+    std::uint64_t quotient = 0;
+    denominator.shift_left(55);
+    for (int bit = 55; bit >= 0; bit--) {
+        if (numerator >= denominator) {
+            numerator.subtract(denominator);
+            quotient |= std::uint64_t{1} << bit;
+        }
+        denominator.shift_right_one();
+    }
+
+    // Round to nearest, ties to even; the remainder breaks ties
+    const int dropped_bits = static_cast<int>(std::bit_width(quotient)) - 53;
+    const std::uint64_t dropped =
+        quotient & ((std::uint64_t{1} << dropped_bits) - 1);
+    const std::uint64_t half = std::uint64_t{1} << (dropped_bits - 1);
+    std::uint64_t significand = quotient >> dropped_bits;
+    if (dropped > half ||
+        (dropped == half && (!numerator.is_zero() || (significand & 1) != 0)))
+        significand++;
+
+    // The value is significand * 2^exponent
+    int exponent = dropped_bits - scale;
+    if (significand == std::uint64_t{1} << 53) {
+        significand >>= 1;
+        exponent++;
+    }
+
+    const int biased_exponent = exponent + 52 + 1023;
+    require(biased_exponent >= 1 && biased_exponent <= 2046, "Invalid number",
+            source_offset);
+    return std::bit_cast<double>(
+        static_cast<std::uint64_t>(biased_exponent) << 52 |
+        (significand & ((std::uint64_t{1} << 52) - 1)));
+}
+
+/// @brief Convert a literal of digits to an int64, as the runtime lexer does
+/// for literals without a decimal point
+/// @return The value, or std::nullopt if the literal has a decimal point or
+/// does not fit, and is a double
+constexpr std::optional<std::int64_t> parse_integer(std::string_view literal) {
+    std::int64_t value = 0;
+    for (const char c : literal)
+        if (c == '.' || __builtin_mul_overflow(value, 10, &value) ||
+            __builtin_add_overflow(value, c - '0', &value))
+            return std::nullopt;
+    return value;
+}
+
+/// @brief A token of the expression text
+struct Lexeme {
+    TokenType type;
+    std::uint32_t source_offset;
+    std::uint32_t length;
+};
+
+/// @brief A node of the expression tree, which compile() builds from the
+/// postfix tokens and StaticExpression walks with one template instance per
+/// node
+struct Node {
+    TokenType type = TokenType::INTEGER;
+    Type result_type = Type::NUMBER;
+    // The value of a number literal
+    double number = 0.0;
+    // The operands of an operator, or the slot of a variable
+    std::uint32_t left = 0;
+    std::uint32_t right = 0;
+};
+
+/// @brief The typed expression tree of an expression text of N characters,
+/// which has at most N tokens
+template <size_t N> struct Program {
+    std::array<Node, N> nodes{};
+    std::uint32_t node_count = 0;
+    std::uint32_t root = 0;
+
+    // The variable names as offsets into the text, in slot order
+    std::array<Lexeme, N> variables{};
+    std::uint32_t variable_count = 0;
+};
+
+constexpr bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' ||
+           c == '\r';
+}
+
+constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+constexpr bool is_identifier_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+/// @brief Split an expression into tokens by the rules of lexer::Lexer
+/// @return The number of tokens written to lexemes
+template <size_t N>
+constexpr size_t tokenize(std::string_view expression,
+                          std::array<Lexeme, N> &lexemes) {
+    size_t count = 0;
+    size_t position = 0;
+    bool last_was_operator_or_lparen = true;
+    const auto emit = [&](TokenType type, size_t start) {
+        lexemes[count++] = Lexeme{type, static_cast<std::uint32_t>(start),
+                                  static_cast<std::uint32_t>(position - start)};
+    };
+
+    while (position < expression.size()) {
+        const char current = expression[position];
+        const size_t start = position;
+
+        if (is_space(current)) {
+            position++;
+            continue;
+        }
+
+        if (is_digit(current) ||
+            (current == '.' && position + 1 < expression.size() &&
+             is_digit(expression[position + 1]))) {
+            bool has_dot = false;
+            while (position < expression.size() &&
+                   (is_digit(expression[position]) ||
+                    expression[position] == '.')) {
+                if (expression[position] == '.') {
+                    require(!has_dot, "Invalid number: multiple decimal points",
+                            start);
+                    has_dot = true;
+                }
+                position++;
+            }
+
+            emit(TokenType::FLOAT, start);
+            last_was_operator_or_lparen = false;
+            continue;
+        }
+
+        if (is_identifier_start(current)) {
+            while (position < expression.size() &&
+                   (is_identifier_start(expression[position]) ||
+                    is_digit(expression[position])))
+                position++;
+
+            const std::string_view word =
+                expression.substr(start, position - start);
+            emit(word == "true"    ? TokenType::TRUE
+                 : word == "false" ? TokenType::FALSE
+                                   : TokenType::IDENTIFIER,
+                 start);
+            last_was_operator_or_lparen = false;
+            continue;
+        }
+
+        const std::string_view two_chars = expression.substr(position, 2);
+        TokenType type = TokenType::LEFT_PAREN;
+        if (two_chars == "==")
+            type = TokenType::EQUAL;
+        else if (two_chars == "!=")
+            type = TokenType::NOT_EQUAL;
+        else if (two_chars == ">=")
+            type = TokenType::GREATER_EQUAL;
+        else if (two_chars == "<=")
+            type = TokenType::LESS_EQUAL;
+        else if (two_chars == "&&")
+            type = TokenType::AND;
+        else if (two_chars == "||")
+            type = TokenType::OR;
+
+        if (type != TokenType::LEFT_PAREN)
+            position += 2;
+        else {
+            switch (current) {
+            case '+':
+                type = TokenType::PLUS;
+                break;
+            case '-':
+                type = last_was_operator_or_lparen ? TokenType::UNARY_MINUS
+                                                   : TokenType::MINUS;
+                break;
+            case '*':
+                type = TokenType::MULTIPLY;
+                break;
+            case '/':
+                type = TokenType::DIVIDE;
+                break;
+            case '^':
+                type = TokenType::POWER;
+                break;
+            case '>':
+                type = TokenType::GREATER;
+                break;
+            case '<':
+                type = TokenType::LESS;
+                break;
+            case '(':
+                type = TokenType::LEFT_PAREN;
+                break;
+            case ')':
+                type = TokenType::RIGHT_PAREN;
+                break;
+            default:
+                require(false, "Unexpected character", start);
+            }
+            position++;
+        }
+
+        emit(type, start);
+        last_was_operator_or_lparen = type != TokenType::RIGHT_PAREN;
+    }
+
+    return count;
+}
+
+/// @brief Reorder tokens into postfix order with the shunting-yard rules of
+/// parser::PostfixStream
+/// @return The number of tokens written to postfix
+template <size_t N>
+constexpr size_t to_postfix(const std::array<Lexeme, N> &infix, size_t count,
+                            std::array<Lexeme, N> &postfix) {
+    std::array<Lexeme, N> operators{};
+    size_t operator_count = 0;
+    size_t output_count = 0;
+
+    for (size_t index = 0; index < count; index++) {
+        const Lexeme &token = infix[index];
+        if (token.type == TokenType::FLOAT || token.type == TokenType::TRUE ||
+            token.type == TokenType::FALSE ||
+            token.type == TokenType::IDENTIFIER)
+            postfix[output_count++] = token;
+        else if (token.type == TokenType::LEFT_PAREN)
+            operators[operator_count++] = token;
+        else if (token.type == TokenType::RIGHT_PAREN) {
+            while (true) {
+                require(operator_count != 0,
+                        "Syntax error: mismatched parentheses",
+                        token.source_offset);
+                const Lexeme top = operators[--operator_count];
+                if (top.type == TokenType::LEFT_PAREN)
+                    break;
+                postfix[output_count++] = top;
+            }
+        } else {
+            const int precedence = parser::get_precedence(token.type);
+            while (operator_count != 0 &&
+                   operators[operator_count - 1].type !=
+                       TokenType::LEFT_PAREN) {
+                const int top_precedence = parser::get_precedence(
+                    operators[operator_count - 1].type);
+                const bool should_pop =
+                    parser::is_right_associative(token.type)
+                        ? top_precedence > precedence
+                        : top_precedence >= precedence;
+                if (!should_pop)
+                    break;
+                postfix[output_count++] = operators[--operator_count];
+            }
+            operators[operator_count++] = token;
+        }
+    }
+
+    while (operator_count != 0) {
+        const Lexeme top = operators[--operator_count];
+        require(top.type != TokenType::LEFT_PAREN,
+                "Syntax error: mismatched parentheses", top.source_offset);
+        postfix[output_count++] = top;
+    }
+
+    return output_count;
+}
+
+/// @brief Build the typed tree of an expression, with the same variable
+/// slots as compiler::compile
+template <size_t N> constexpr Program<N> parse(std::string_view expression) {
+    std::array<Lexeme, N> infix{};
+    std::array<Lexeme, N> postfix{};
+    const size_t count =
+        to_postfix(infix, tokenize(expression, infix), postfix);
+
+    Program<N> program;
+    // The nodes of the operands not yet consumed by an operator
+    std::array<std::uint32_t, N> operands{};
+    // The exact value of each operand that is an integer literal or computed
+    // from them, whose operators are applied here in int64 as at runtime,
+    // see evaluator::apply_integers()
+    std::array<std::optional<std::int64_t>, N> integers{};
+    size_t depth = 0;
+    const auto add = [&program](const Node &node) {
+        program.nodes[program.node_count] = node;
+        return program.node_count++;
+    };
+
+    for (size_t index = 0; index < count; index++) {
+        const Lexeme &token = postfix[index];
+        const std::string_view text =
+            expression.substr(token.source_offset, token.length);
+
+        if (token.type == TokenType::FLOAT) {
+            integers[depth] = parse_integer(text);
+            operands[depth++] = add(Node{
+                token.type, Type::NUMBER,
+                parse_number(text, token.source_offset), 0, 0});
+        } else if (token.type == TokenType::TRUE ||
+                   token.type == TokenType::FALSE) {
+            integers[depth] = std::nullopt;
+            operands[depth++] = add(Node{token.type, Type::BOOLEAN, 0.0, 0, 0});
+        } else if (token.type == TokenType::IDENTIFIER) {
+            std::uint32_t slot = 0;
+            while (slot < program.variable_count &&
+                   expression.substr(program.variables[slot].source_offset,
+                                     program.variables[slot].length) != text)
+                slot++;
+            if (slot == program.variable_count)
+                program.variables[program.variable_count++] = token;
+
+            integers[depth] = std::nullopt;
+            operands[depth++] =
+                add(Node{token.type, Type::NUMBER, 0.0, slot, 0});
+        } else if (token.type == TokenType::UNARY_MINUS) {
+            require(depth >= 1, "Invalid expression: missing operand",
+                    token.source_offset);
+            const std::uint32_t operand = operands[depth - 1];
+            require(program.nodes[operand].result_type == Type::NUMBER,
+                    "Type error: Expected number, got boolean",
+                    token.source_offset);
+
+            std::optional<std::int64_t> &integer = integers[depth - 1];
+            if (integer)
+                integer = evaluator::negate_integer(*integer);
+            operands[depth - 1] =
+                integer ? add(Node{TokenType::FLOAT, Type::NUMBER,
+                                   static_cast<double>(*integer), 0, 0})
+                        : add(Node{token.type, Type::NUMBER, 0.0, operand, 0});
+        } else {
+            require(depth >= 2, "Invalid expression: insufficient operands",
+                    token.source_offset);
+            const std::uint32_t left = operands[depth - 2];
+            const std::uint32_t right = operands[depth - 1];
+            const Type left_type = program.nodes[left].result_type;
+            const Type right_type = program.nodes[right].result_type;
+
+            Type result_type = Type::BOOLEAN;
+            switch (token.type) {
+            case TokenType::EQUAL:
+            case TokenType::NOT_EQUAL:
+                require(left_type == right_type,
+                        "Type error: type mismatch in comparison",
+                        token.source_offset);
+                break;
+            case TokenType::AND:
+            case TokenType::OR:
+                require(left_type == Type::BOOLEAN &&
+                            right_type == Type::BOOLEAN,
+                        "Type error: Expected boolean, got number",
+                        token.source_offset);
+                break;
+            case TokenType::GREATER:
+            case TokenType::LESS:
+            case TokenType::GREATER_EQUAL:
+            case TokenType::LESS_EQUAL:
+                require(left_type == Type::NUMBER && right_type == Type::NUMBER,
+                        "Type error: Expected number, got boolean",
+                        token.source_offset);
+                break;
+            default:
+                require(left_type == Type::NUMBER && right_type == Type::NUMBER,
+                        "Type error: Expected number, got boolean",
+                        token.source_offset);
+                result_type = Type::NUMBER;
+            }
+
+            depth--;
+            const std::optional<std::int64_t> left_integer =
+                integers[depth - 1];
+            const std::optional<std::int64_t> right_integer = integers[depth];
+            integers[depth - 1] = std::nullopt;
+            if (left_integer && right_integer) {
+                if (const std::optional<bool> compared =
+                        evaluator::compare_integers(
+                            token.type, *left_integer, *right_integer)) {
+                    operands[depth - 1] = add(
+                        Node{*compared ? TokenType::TRUE : TokenType::FALSE,
+                             Type::BOOLEAN, 0.0, 0, 0});
+                    continue;
+                }
+
+                integers[depth - 1] = evaluator::apply_integers(
+                    token.type, *left_integer, *right_integer);
+                if (integers[depth - 1]) {
+                    operands[depth - 1] = add(
+                        Node{TokenType::FLOAT, Type::NUMBER,
+                             static_cast<double>(*integers[depth - 1]), 0, 0});
+                    continue;
+                }
+            }
+
+            operands[depth - 1] =
+                add(Node{token.type, result_type, 0.0, left, right});
+        }
+    }
+
+    require(depth == 1, "Syntax error: too many operands", expression.size());
+    program.root = operands[0];
+    return program;
+}
+
+template <typename T>
+concept Number = std::convertible_to<T, double> &&
+                 !std::same_as<std::remove_cvref_t<T>, bool>;
+} // namespace detail
+
+/// @brief An expression lexed, parsed and type-checked at compile time.
+/// evaluate() is a tree of inlined operations on its arguments, with no
+/// tokens, program or value stack left at runtime.
+///
+/// Variables are numbers, bound by evaluate() in the slot order of
+/// compiler::compile, so the type of every subexpression is known: type
+/// errors are compile errors, and evaluate() returns a double or a bool.
+/// Results otherwise match CompiledExpression::evaluate, including
+/// short-circuiting && and ||. Being statically typed, `false && 1` is
+/// rejected although compiled programs never check its right operand
+/// @tparam text The expression
+template <ExpressionText text> class StaticExpression {
+  private:
+    static constexpr detail::Program<text.size()> program =
+        detail::parse<text.size()>(text.view());
+
+    template <std::uint32_t index>
+    static constexpr auto
+    evaluate_node(const std::array<double, program.variable_count> &bindings) {
+        constexpr detail::Node node = program.nodes[index];
+
+        if constexpr (node.type == TokenType::FLOAT)
+            return node.number;
+        else if constexpr (node.type == TokenType::TRUE)
+            return true;
+        else if constexpr (node.type == TokenType::FALSE)
+            return false;
+        else if constexpr (node.type == TokenType::IDENTIFIER)
+            return bindings[node.left];
+        else if constexpr (node.type == TokenType::UNARY_MINUS)
+            return -evaluate_node<node.left>(bindings);
+        else if constexpr (node.type == TokenType::AND)
+            return evaluate_node<node.left>(bindings) &&
+                   evaluate_node<node.right>(bindings);
+        else if constexpr (node.type == TokenType::OR)
+            return evaluate_node<node.left>(bindings) ||
+                   evaluate_node<node.right>(bindings);
+        else {
+            const auto left = evaluate_node<node.left>(bindings);
+            const auto right = evaluate_node<node.right>(bindings);
+
+            if constexpr (node.type == TokenType::PLUS)
+                return left + right;
+            else if constexpr (node.type == TokenType::MINUS)
+                return left - right;
+            else if constexpr (node.type == TokenType::MULTIPLY)
+                return left * right;
+            else if constexpr (node.type == TokenType::DIVIDE) {
+                if (right == 0.0)
+                    Error(ErrorCode::DIVISION_BY_ZERO).raise();
+                return left / right;
+            } else if constexpr (node.type == TokenType::POWER)
+                return evaluator::power(left, right);
+            else if constexpr (node.type == TokenType::EQUAL)
+                return left == right;
+            else if constexpr (node.type == TokenType::NOT_EQUAL)
+                return left != right;
+            else if constexpr (node.type == TokenType::GREATER)
+                return left > right;
+            else if constexpr (node.type == TokenType::LESS)
+                return left < right;
+            else if constexpr (node.type == TokenType::GREATER_EQUAL)
+                return left >= right;
+            else
+                return left <= right;
+        }
+    }
+
+  public:
+    static constexpr size_t variable_count = program.variable_count;
+
+    using result_type =
+        std::conditional_t<program.nodes[program.root].result_type ==
+                               Type::BOOLEAN,
+                           bool, double>;
+
+    /// @brief Returns the variable names in slot order
+    [[nodiscard]] static constexpr std::array<std::string_view, variable_count>
+    get_variables() noexcept {
+        std::array<std::string_view, variable_count> names{};
+        for (size_t slot = 0; slot < variable_count; slot++)
+            names[slot] =
+                text.view().substr(program.variables[slot].source_offset,
+                                   program.variables[slot].length);
+        return names;
+    }
+
+    /// @brief Evaluate the expression, also in constant expressions as long
+    /// as no `^` falls back to std::pow (GCC evaluates that too), which exact
+    /// integer powers never do
+    /// @param values The value of each variable, in slot order
+    /// @throws std::runtime_error on division by zero
+    template <detail::Number... Values>
+        requires(sizeof...(Values) == variable_count)
+    [[nodiscard]] constexpr result_type evaluate(Values... values) const {
+        const std::array<double, variable_count> bindings{
+            static_cast<double>(values)...};
+        return evaluate_node<program.root>(bindings);
+    }
+};
+
+/// @brief Compile an expression at compile time. Malformed expressions and
+/// type errors are compile errors, whose diagnostics show the message and
+/// source offset
+/// @tparam text The expression, e.g. compile<"2 ^ 10 * x">()
+template <ExpressionText text>
+[[nodiscard]] consteval StaticExpression<text> compile() {
+    return {};
+}
+
+inline namespace literals {
+/// @brief Compile an expression at compile time, e.g. "2 ^ 10 * x"_expr
+template <ExpressionText text>
+[[nodiscard]] consteval StaticExpression<text> operator""_expr() {
+    return {};
+}
+} // namespace literals
+} // namespace expression_evaluator::static_expression
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace expression_evaluator::stats {
+/// @brief The instrumented entry points. Stages nest: COMPILE includes the
+/// TOKENIZE and TO_POSTFIX it runs
+enum class Stage : std::uint8_t {
+    // lexer::try_tokenize and tokenize
+    TOKENIZE,
+    // parser::try_to_postfix and to_postfix
+    TO_POSTFIX,
+    // evaluator::try_evaluate_expression and evaluate_expression
+    EVALUATE_POSTFIX,
+    // The fused pipeline of evaluator::try_evaluate and evaluate
+    EVALUATE,
+    // compiler::try_compile and compile
+    COMPILE,
+    // Running a compiled program, e.g. CompiledExpression::evaluate
+    EXECUTE,
+};
+
+constexpr size_t STAGE_COUNT = static_cast<size_t>(Stage::EXECUTE) + 1;
+
+/// @brief Bucket 0 counts calls that took less than 1 ns, bucket i > 0 calls
+/// that took [2^(i-1), 2^i) ns, and the last bucket also longer ones
+constexpr size_t HISTOGRAM_BUCKETS = 32;
+
+// Instrumentation is compiled in unless the stats option is turned off, and
+// records nothing until enabled at runtime
+#ifndef EXPRESSION_EVALUATOR_NO_STATS
+constexpr bool COMPILED_IN = true;
+#else
+constexpr bool COMPILED_IN = false;
+#endif
+
+struct StageStats {
+    std::uint64_t calls = 0;
+    // Tokens produced or consumed; COMPILE and EXECUTE count none
+    std::uint64_t tokens = 0;
+    // Calls that returned or threw an error
+    std::uint64_t errors = 0;
+    // Allocations by the token and value containers (not by other code)
+    std::uint64_t allocations = 0;
+    std::uint64_t total_nanoseconds = 0;
+    std::array<std::uint64_t, HISTOGRAM_BUCKETS> histogram{};
+
+    /// @brief Returns the mean duration of a call, or 0 without calls
+    [[nodiscard]] double mean_nanoseconds() const noexcept;
+
+    /// @brief Returns an upper bound on the duration within which a fraction
+    /// of the calls completed, from the histogram, or 0 without calls
+    /// @param fraction The fraction of calls, e.g. 0.99
+    [[nodiscard]] std::uint64_t
+    percentile_nanoseconds(double fraction) const noexcept;
+};
+
+/// @brief Counters of every thread, summed at one point in time
+struct Snapshot {
+    std::array<StageStats, STAGE_COUNT> stages{};
+    // Errors thrown by the throwing API, e.g. by Result::value()
+    std::uint64_t exceptions = 0;
+
+    [[nodiscard]] const StageStats &operator[](Stage stage) const noexcept {
+        return stages[static_cast<size_t>(stage)];
+    }
+
+    /// @brief Format a table of the stages that were called, for people
+    [[nodiscard]] std::string to_string() const;
+};
+
+namespace detail {
+#ifndef EXPRESSION_EVALUATOR_NO_STATS
+inline std::atomic<bool> enabled{false};
+#endif
+} // namespace detail
+
+/// @brief Returns the name of a stage, e.g. "tokenize"
+[[nodiscard]] const char *stage_name(Stage stage) noexcept;
+
+/// @brief Start or stop recording on every thread. Without recording, each
+/// instrumented call only checks a flag. Does nothing if not COMPILED_IN
+void set_enabled(bool enabled) noexcept;
+
+[[nodiscard]] inline bool is_enabled() noexcept {
+#ifndef EXPRESSION_EVALUATOR_NO_STATS
+    return detail::enabled.load(std::memory_order_relaxed);
+#else
+    return false;
+#endif
+}
+
+/// @brief Returns the counters recorded since the last reset(), including
+/// those of threads that have exited
+[[nodiscard]] Snapshot snapshot();
+
+/// @brief Start counting from zero again
+void reset();
+
+namespace detail {
+#ifndef EXPRESSION_EVALUATOR_NO_STATS
+// Allocations by the calling thread's containers, so that stages can count
+// theirs as a difference
+inline thread_local std::uint64_t allocation_count = 0;
+
+inline void note_allocation() noexcept { allocation_count++; }
+
+void note_exception() noexcept;
+
+/// @brief Records one call to a stage when destroyed, if recording was
+/// enabled when it was created
+class StageTimer {
+  private:
+    std::chrono::steady_clock::time_point start;
+    std::uint64_t start_allocations = 0;
+    std::uint64_t tokens = 0;
+    Stage stage;
+    bool active;
+    bool failed = false;
+
+  public:
+    explicit StageTimer(Stage stage) noexcept
+        : stage(stage), active(is_enabled()) {
+        if (active) [[unlikely]] {
+            start_allocations = allocation_count;
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+    ~StageTimer() {
+        if (active) [[unlikely]]
+            record();
+    }
+
+    void add_tokens(size_t count) noexcept { tokens += count; }
+
+    void fail() noexcept { failed = true; }
+
+  private:
+    void record() noexcept;
+};
+#else
+inline void note_allocation() noexcept {}
+
+inline void note_exception() noexcept {}
+
+class StageTimer {
+  public:
+    explicit StageTimer(Stage) noexcept {}
+
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+    void add_tokens(size_t) noexcept {}
+
+    void fail() noexcept {}
+};
+#endif
+} // namespace detail
+} // namespace expression_evaluator::stats
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "../stats.hpp"
+
+namespace expression_evaluator::structures {
+/// @brief Stack stored contiguously in a growable array, with the same
+/// interface as Stack
+template <typename T> class ArrayStack {
+  private:
+    std::vector<T> items;
+
+    void note_growth() noexcept {
+        if (items.size() == items.capacity())
+            stats::detail::note_allocation();
+    }
+
+  public:
+    /// @brief Ensure the stack can hold at least capacity elements without
+    /// reallocating
+    void reserve(size_t capacity) {
+        if (capacity > items.capacity())
+            stats::detail::note_allocation();
+        items.reserve(capacity);
+    }
+
+    /// @brief Add an element to the top of the stack by copy
+    void push(const T &value) {
+        note_growth();
+        items.push_back(value);
+    }
+
+    /// @brief Add an element to the top of the stack by move
+    void push(T &&value) {
+        note_growth();
+        items.push_back(std::move(value));
+    }
+
+    /// @brief Remove and return the top element of the stack
+    /// @throws std::runtime_error if the stack is empty
+    T pop() {
+        if (is_empty())
+            throw std::runtime_error("Cannot pop from empty stack");
+
+        T value = std::move(items.back());
+        items.pop_back();
+        return value;
+    }
+
+    /// @brief Return a reference to the top element of the stack
+    /// @throws std::runtime_error if the stack is empty
+    T &top() {
+        if (is_empty())
+            throw std::runtime_error("Cannot peek from empty stack");
+
+        return items.back();
+    }
+
+    /// @brief Return a const reference to the top element of the stack
+    /// @throws std::runtime_error if the stack is empty
+    const T &top() const {
+        if (is_empty())
+            throw std::runtime_error("Cannot peek from empty stack");
+
+        return items.back();
+    }
+
+    /// @brief Return whether the stack is empty
+    [[nodiscard]] bool is_empty() const noexcept { return items.empty(); }
+
+    /// @brief Return the number of elements in the stack
+    [[nodiscard]] size_t size() const noexcept { return items.size(); }
+};
+} // namespace expression_evaluator::structures
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "array_stack.hpp"
+#include "queue.hpp"
+#include "ring_queue.hpp"
+#include "stack.hpp"
+
+namespace expression_evaluator::structures {
+// The containers used by the lexer, parser and evaluator. Building with the
+// `contiguous_containers` Meson option switches them from the linked-list
+// Queue/Stack to RingQueue/ArrayStack
+#ifdef EXPRESSION_EVALUATOR_CONTIGUOUS_CONTAINERS
+template <typename T> using DefaultQueue = RingQueue<T>;
+template <typename T> using DefaultStack = ArrayStack<T>;
+#else
+template <typename T> using DefaultQueue = Queue<T>;
+template <typename T> using DefaultStack = Stack<T>;
+#endif
+} // namespace expression_evaluator::structures
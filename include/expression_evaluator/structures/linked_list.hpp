@@ -4,8 +4,13 @@
 #include <stdexcept>
 #include <utility>
 
+#include "node_allocator.hpp"
+
 namespace expression_evaluator::structures {
-template <typename T> class LinkedList {
+/// @tparam Allocator Node allocation policy, e.g. HeapAllocator or
+/// PoolAllocator
+template <typename T, template <typename> class Allocator = PoolAllocator>
+class LinkedList {
   private:
     struct Node {
         T data;
@@ -18,6 +23,8 @@ template <typename T> class LinkedList {
             : data(std::forward<U>(value)), next(nullptr) {}
     };
 
+    using NodeAllocator = Allocator<Node>;
+
     Node *head;
     Node *tail;
     size_t size;
@@ -53,7 +60,7 @@ template <typename T> class LinkedList {
 
     /// @brief Add an element to the front of the list by copy
     void push_front(const T &value) {
-        Node *new_node = new Node(value);
+        Node *new_node = NodeAllocator::create(value);
         new_node->next = head;
 
         head = new_node;
@@ -65,7 +72,7 @@ template <typename T> class LinkedList {
 
     /// @brief Add an element to the front of the list by move
     void push_front(T &&value) {
-        Node *new_node = new Node(std::move(value));
+        Node *new_node = NodeAllocator::create(std::move(value));
         new_node->next = head;
 
         head = new_node;
@@ -77,7 +84,7 @@ template <typename T> class LinkedList {
 
     /// @brief Add an element to the end of the list by copy
     void push_back(const T &value) {
-        Node *new_node = new Node(value);
+        Node *new_node = NodeAllocator::create(value);
         if (tail == nullptr)
             head = tail = new_node;
         else {
@@ -90,7 +97,7 @@ template <typename T> class LinkedList {
 
     /// @brief Add an element to the end of the list by move
     void push_back(T &&value) {
-        Node *new_node = new Node(std::move(value));
+        Node *new_node = NodeAllocator::create(std::move(value));
         if (tail == nullptr)
             head = tail = new_node;
         else {
@@ -113,7 +120,7 @@ template <typename T> class LinkedList {
         if (head == nullptr)
             tail = nullptr;
 
-        delete temp;
+        NodeAllocator::destroy(temp);
         size--;
         return value;
     }
@@ -146,7 +153,7 @@ template <typename T> class LinkedList {
     void clear() noexcept {
         while (head != nullptr) {
             Node *next = head->next;
-            delete head;
+            NodeAllocator::destroy(head);
             head = next;
         }
         tail = nullptr;
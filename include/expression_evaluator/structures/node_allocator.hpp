@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#include "../stats.hpp"
+
+namespace expression_evaluator::structures {
+/// @brief Node allocator that creates every node with global operator new
+template <typename Node> struct HeapAllocator {
+    template <typename... Args> static Node *create(Args &&...args) {
+        stats::detail::note_allocation();
+        return new Node(std::forward<Args>(args)...);
+    }
+
+    static void destroy(Node *node) noexcept { delete node; }
+};
+
+/// @brief Node allocator that recycles destroyed nodes through a thread-local
+/// free list, so that once a thread has reached its peak number of live nodes
+/// it no longer calls global operator new.
+///
+/// Every node is allocated individually, so a node may be destroyed on a
+/// different thread than the one that created it (e.g. after moving a list).
+/// Cached nodes are freed when their thread exits, or by release().
+template <typename Node> class PoolAllocator {
+  private:
+    struct FreeNode {
+        FreeNode *next;
+    };
+
+    static constexpr size_t slot_size =
+        sizeof(Node) > sizeof(FreeNode) ? sizeof(Node) : sizeof(FreeNode);
+    static constexpr std::align_val_t slot_alignment{
+        alignof(Node) > alignof(FreeNode) ? alignof(Node) : alignof(FreeNode)};
+
+    struct FreeList {
+        FreeNode *head = nullptr;
+        size_t size = 0;
+
+        ~FreeList() { release(); }
+
+        void release() noexcept {
+            while (head != nullptr) {
+                FreeNode *next = head->next;
+                ::operator delete(head, slot_alignment);
+                head = next;
+            }
+            size = 0;
+        }
+    };
+
+    static FreeList &free_list() noexcept {
+        thread_local FreeList list;
+        return list;
+    }
+
+  public:
+    template <typename... Args> static Node *create(Args &&...args) {
+        FreeList &list = free_list();
+
+        void *memory;
+        if (list.head != nullptr) {
+            memory = list.head;
+            list.head = list.head->next;
+            list.size--;
+        } else {
+            stats::detail::note_allocation();
+            memory = ::operator new(slot_size, slot_alignment);
+        }
+
+        try {
+            return new (memory) Node(std::forward<Args>(args)...);
+        } catch (...) {
+            list.head = new (memory) FreeNode{list.head};
+            list.size++;
+            throw;
+        }
+    }
+
+    static void destroy(Node *node) noexcept {
+        node->~Node();
+
+        FreeList &list = free_list();
+        list.head = new (static_cast<void *>(node)) FreeNode{list.head};
+        list.size++;
+    }
+
+    /// @brief Free all nodes cached by the calling thread
+    static void release() noexcept { free_list().release(); }
+
+    /// @brief Returns the number of nodes cached by the calling thread
+    [[nodiscard]] static size_t cached_count() noexcept {
+        return free_list().size;
+    }
+};
+} // namespace expression_evaluator::structures
@@ -3,31 +3,31 @@
 #include "linked_list.hpp"
 
 namespace expression_evaluator::structures {
-template <typename T> class Queue : private LinkedList<T> {
+template <typename T, template <typename> class Allocator = PoolAllocator>
+class Queue : private LinkedList<T, Allocator> {
+  private:
+    using List = LinkedList<T, Allocator>;
+
   public:
     /// @brief Add an element to the end of the queue by copy
-    void enqueue(const T &value) { LinkedList<T>::push_back(value); }
+    void enqueue(const T &value) { List::push_back(value); }
 
     /// @brief Add an element to the end of the queue by move
-    void enqueue(T &&value) { LinkedList<T>::push_back(std::move(value)); }
+    void enqueue(T &&value) { List::push_back(std::move(value)); }
 
     /// @brief Remove and return the element at the front of the queue
-    T dequeue() { return LinkedList<T>::pop_front(); }
+    T dequeue() { return List::pop_front(); }
 
     /// @brief Return a reference to the front element of the queue
-    T &front() { return LinkedList<T>::peek_front(); }
+    T &front() { return List::peek_front(); }
 
     /// @brief Return a const reference to the front element of the queue
-    const T &front() const { return LinkedList<T>::peek_front(); }
+    const T &front() const { return List::peek_front(); }
 
     /// @brief Returns whether the queue is empty
-    [[nodiscard]] bool is_empty() const noexcept {
-        return LinkedList<T>::is_empty();
-    }
+    [[nodiscard]] bool is_empty() const noexcept { return List::is_empty(); }
 
     /// @brief Returns the number of elements in the queue
-    [[nodiscard]] size_t size() const noexcept {
-        return LinkedList<T>::get_size();
-    }
+    [[nodiscard]] size_t size() const noexcept { return List::get_size(); }
 };
 } // namespace expression_evaluator::structures
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include "../stats.hpp"
+
+namespace expression_evaluator::structures {
+/// @brief Queue stored contiguously in a growable ring buffer, with the same
+/// interface as Queue
+template <typename T> class RingQueue {
+  private:
+    T *buffer;
+    size_t capacity;
+    size_t head;
+    size_t count;
+
+    // Capacity is kept a power of two so wrapping is a mask
+    [[nodiscard]] size_t wrap(size_t index) const noexcept {
+        return index & (capacity - 1);
+    }
+
+    void grow(size_t min_capacity) {
+        size_t new_capacity = capacity == 0 ? 8 : capacity;
+        while (new_capacity < min_capacity)
+            new_capacity *= 2;
+
+        if (new_capacity == capacity)
+            return;
+
+        stats::detail::note_allocation();
+        std::allocator<T> allocator;
+        T *new_buffer = allocator.allocate(new_capacity);
+        for (size_t i = 0; i < count; i++) {
+            T &element = buffer[wrap(head + i)];
+            new (new_buffer + i) T(std::move(element));
+            element.~T();
+        }
+
+        if (buffer != nullptr)
+            allocator.deallocate(buffer, capacity);
+
+        buffer = new_buffer;
+        capacity = new_capacity;
+        head = 0;
+    }
+
+  public:
+    RingQueue() : buffer(nullptr), capacity(0), head(0), count(0) {}
+    ~RingQueue() {
+        clear();
+        if (buffer != nullptr)
+            std::allocator<T>{}.deallocate(buffer, capacity);
+    }
+
+    // Do not support copy semantics for simplicity
+    RingQueue(const RingQueue &) = delete;
+    RingQueue &operator=(const RingQueue &) = delete;
+
+    RingQueue(RingQueue &&other) noexcept
+        : buffer(other.buffer), capacity(other.capacity), head(other.head),
+          count(other.count) {
+        other.buffer = nullptr;
+        other.capacity = 0;
+        other.head = 0;
+        other.count = 0;
+    }
+
+    RingQueue &operator=(RingQueue &&other) noexcept {
+        if (this == &other)
+            return *this;
+
+        this->~RingQueue();
+        new (this) RingQueue(std::move(other));
+        return *this;
+    }
+
+    /// @brief Ensure the queue can hold at least new_capacity elements
+    /// without reallocating
+    void reserve(size_t new_capacity) {
+        if (new_capacity > capacity)
+            grow(new_capacity);
+    }
+
+    /// @brief Add an element to the end of the queue by copy
+    void enqueue(const T &value) {
+        if (count == capacity)
+            grow(count + 1);
+
+        new (buffer + wrap(head + count)) T(value);
+        count++;
+    }
+
+    /// @brief Add an element to the end of the queue by move
+    void enqueue(T &&value) {
+        if (count == capacity)
+            grow(count + 1);
+
+        new (buffer + wrap(head + count)) T(std::move(value));
+        count++;
+    }
+
+    /// @brief Remove and return the element at the front of the queue
+    /// @throws std::runtime_error if the queue is empty
+    T dequeue() {
+        if (is_empty())
+            throw std::runtime_error("Cannot dequeue from empty queue");
+
+        T value = std::move(buffer[head]);
+        buffer[head].~T();
+        head = wrap(head + 1);
+        count--;
+        return value;
+    }
+
+    /// @brief Return a reference to the front element of the queue
+    /// @throws std::runtime_error if the queue is empty
+    T &front() {
+        if (is_empty())
+            throw std::runtime_error("Cannot peek from empty queue");
+
+        return buffer[head];
+    }
+
+    /// @brief Return a const reference to the front element of the queue
+    /// @throws std::runtime_error if the queue is empty
+    const T &front() const {
+        if (is_empty())
+            throw std::runtime_error("Cannot peek from empty queue");
+
+        return buffer[head];
+    }
+
+    /// @brief Returns whether the queue is empty
+    [[nodiscard]] bool is_empty() const noexcept { return count == 0; }
+
+    /// @brief Returns the number of elements in the queue
+    [[nodiscard]] size_t size() const noexcept { return count; }
+
+    /// @brief Remove all elements, keeping the allocated capacity
+    void clear() noexcept {
+        for (size_t i = 0; i < count; i++)
+            buffer[wrap(head + i)].~T();
+
+        head = 0;
+        count = 0;
+    }
+};
+} // namespace expression_evaluator::structures
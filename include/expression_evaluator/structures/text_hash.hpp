@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace expression_evaluator::structures {
+/// @brief 64-bit FNV-1a hash of a string
+struct TextHash {
+    [[nodiscard]] size_t operator()(std::string_view text) const noexcept {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (const char c : text) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+
+        return static_cast<size_t>(hash);
+    }
+};
+} // namespace expression_evaluator::structures
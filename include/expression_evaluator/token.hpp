@@ -1,17 +1,22 @@
 #pragma once
 
-#include <string>
-#include <variant>
+#include <cstdint>
+#include <string_view>
+
+#include <expression_evaluator/structures/containers.hpp>
 
 namespace expression_evaluator {
 
-enum class TokenType {
+enum class TokenType : std::uint8_t {
     // Literals
     INTEGER,
     FLOAT,
     TRUE,
     FALSE,
 
+    // Variables
+    IDENTIFIER,
+
     // Operators
     PLUS,
     MINUS,
@@ -37,14 +42,70 @@ enum class TokenType {
     RIGHT_PAREN,
 };
 
+/// @brief A token packed into 16 bytes, so that four fit in a cache line: a
+/// type tag, a 32-bit position and an 8-byte payload. TRUE and FALSE need no
+/// payload, as their value is their type
 struct Token {
     TokenType type;
-    std::variant<int, double, bool, std::monostate> value;
 
-    explicit Token(TokenType t) : type(t), value(std::monostate{}) {}
-    Token(TokenType t, int v) : type(t), value(v) {}
-    Token(TokenType t, double v) : type(t), value(v) {}
-    Token(TokenType t, bool v) : type(t), value(v) {}
+  private:
+    // The length of an IDENTIFIER's name, or the offset of any other token
+    // in the tokenized expression
+    std::uint32_t extent;
+    union {
+        std::int64_t integer;
+        double number;
+        // IDENTIFIER tokens point into the tokenized expression string
+        const char *name;
+    } payload;
+
+    Token(TokenType t, std::uint32_t extent, std::int64_t integer)
+        : type(t), extent(extent), payload{.integer = integer} {}
+
+  public:
+    explicit Token(TokenType t, std::uint32_t source_offset = 0)
+        : Token(t, source_offset, 0) {}
+
+    [[nodiscard]] static Token from_integer(std::int64_t value,
+                                            std::uint32_t source_offset = 0) {
+        return Token(TokenType::INTEGER, source_offset, value);
+    }
+
+    [[nodiscard]] static Token from_float(double value,
+                                          std::uint32_t source_offset = 0) {
+        Token token(TokenType::FLOAT, source_offset);
+        token.payload.number = value;
+        return token;
+    }
+
+    /// @param name The name, which must outlive the token and be shorter
+    /// than 4 GiB
+    [[nodiscard]] static Token from_identifier(std::string_view name) {
+        Token token(TokenType::IDENTIFIER,
+                    static_cast<std::uint32_t>(name.size()));
+        token.payload.name = name.data();
+        return token;
+    }
+
+    /// @brief Returns the value of an INTEGER token
+    [[nodiscard]] std::int64_t get_integer() const noexcept {
+        return payload.integer;
+    }
+
+    /// @brief Returns the value of a FLOAT token
+    [[nodiscard]] double get_float() const noexcept { return payload.number; }
+
+    /// @brief Returns the name of an IDENTIFIER token
+    [[nodiscard]] std::string_view get_name() const noexcept {
+        return std::string_view(payload.name, extent);
+    }
+
+    /// @brief Returns the offset of the token in the tokenized expression.
+    /// IDENTIFIER tokens do not store it; their offset is the distance from
+    /// the start of the expression to get_name().data()
+    [[nodiscard]] std::uint32_t get_source_offset() const noexcept {
+        return type == TokenType::IDENTIFIER ? 0 : extent;
+    }
 
     [[nodiscard]] bool is_operator() const noexcept {
         return type == TokenType::PLUS || type == TokenType::MINUS ||
@@ -60,6 +121,14 @@ struct Token {
         return type == TokenType::INTEGER || type == TokenType::FLOAT ||
                type == TokenType::TRUE || type == TokenType::FALSE;
     }
+
+    [[nodiscard]] bool is_operand() const noexcept {
+        return is_literal() || type == TokenType::IDENTIFIER;
+    }
 };
 
+static_assert(sizeof(Token) == 16);
+
+using TokenQueue = structures::DefaultQueue<Token>;
+
 } // namespace expression_evaluator
@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <expression_evaluator/batch.hpp>
+#include <expression_evaluator/compiler.hpp>
+#include <expression_evaluator/lexer.hpp>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+using namespace expression_evaluator;
+using evaluator::Value;
+
+// Input is split into chunks of about this many bytes, at line boundaries,
+// which are the unit of work for parallel evaluation
+constexpr size_t CHUNK_SIZE = 1 << 16;
+
+// Enough for a sign, 17 digits, a point and an exponent
+constexpr size_t NUMBER_DIGITS = 32;
+
+/// @brief Format a number with the same digits as Value::to_string, which
+/// prints max_digits10 significant digits in the default floating-point
+/// format, without allocating
+std::string_view format_number(double number, char (&digits)[NUMBER_DIGITS]) {
+    const std::to_chars_result result = std::to_chars(
+        digits, digits + NUMBER_DIGITS, number, std::chars_format::general,
+        std::numeric_limits<double>::max_digits10);
+    return std::string_view(digits, static_cast<size_t>(result.ptr - digits));
+}
+
+/// @brief Collects the output of one chunk in memory
+struct StringWriter {
+    std::string &text;
+
+    void write(std::string_view part) { text += part; }
+
+    void write(const Value &value) {
+        if (value.is_bool()) {
+            text += value.as_bool() ? "true" : "false";
+            return;
+        }
+
+        char digits[NUMBER_DIGITS];
+        text += format_number(value.as_number(), digits);
+    }
+};
+
+/// @brief Evaluate every line of the input, see batch::evaluate_lines
+template <typename Writer>
+batch::BatchStats evaluate_range(std::string_view input, Writer &output) {
+    batch::BatchStats stats;
+
+    size_t start = 0;
+    while (start < input.size()) {
+        size_t end = input.find('\n', start);
+        if (end == std::string_view::npos)
+            end = input.size();
+
+        std::string_view line = input.substr(start, end - start);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        if (!line.empty()) {
+            // Invalid lines are common, so errors are returned rather than
+            // thrown, and formatted only here
+            const Result<Value> result = batch::try_evaluate_line(line);
+            if (result)
+                output.write(result.value());
+            else {
+                output.write("error: ");
+                output.write(result.get_error().message());
+                stats.errors++;
+            }
+        }
+
+        output.write("\n");
+        stats.lines++;
+        start = end + 1;
+    }
+
+    return stats;
+}
+
+/// @brief Split the input after a newline roughly every CHUNK_SIZE bytes
+std::vector<std::string_view> split_chunks(std::string_view input) {
+    std::vector<std::string_view> chunks;
+    while (!input.empty()) {
+        size_t end = input.size();
+        if (end > CHUNK_SIZE) {
+            const size_t newline = input.find('\n', CHUNK_SIZE - 1);
+            if (newline != std::string_view::npos)
+                end = newline + 1;
+        }
+
+        chunks.push_back(input.substr(0, end));
+        input.remove_prefix(end);
+    }
+
+    return chunks;
+}
+
+struct Chunk {
+    std::string_view input;
+    std::string output;
+    batch::BatchStats stats;
+    // Set by the worker that evaluated the chunk, which publishes the fields
+    // above
+    std::atomic<bool> done{false};
+    std::exception_ptr error;
+};
+
+/// @brief A range [next, end) of chunk indices owned by one worker, packed
+/// into one word so that the owner can take from the front and other workers
+/// can steal from the back without locks
+class alignas(64) WorkRange {
+  private:
+    std::atomic<std::uint64_t> range{0};
+
+    static std::uint64_t pack(std::uint64_t next, std::uint64_t end) {
+        return next << 32 | end;
+    }
+
+  public:
+    void assign(size_t next, size_t end) {
+        range.store(pack(next, end), std::memory_order_release);
+    }
+
+    /// @brief Take the next index of this worker's range
+    std::optional<size_t> take() {
+        std::uint64_t current = range.load(std::memory_order_acquire);
+        while (true) {
+            const std::uint64_t next = current >> 32;
+            const std::uint64_t end = current & UINT32_MAX;
+            if (next >= end)
+                return std::nullopt;
+
+            if (range.compare_exchange_weak(current, pack(next + 1, end),
+                                            std::memory_order_acq_rel))
+                return static_cast<size_t>(next);
+        }
+    }
+
+    /// @brief Move the back half of another worker's range into this
+    /// (empty) one
+    /// @return false if the victim had nothing left
+    bool steal_from(WorkRange &victim) {
+        std::uint64_t current = victim.range.load(std::memory_order_acquire);
+        while (true) {
+            const std::uint64_t next = current >> 32;
+            const std::uint64_t end = current & UINT32_MAX;
+            if (next >= end)
+                return false;
+
+            const std::uint64_t middle = end - (end - next + 1) / 2;
+            if (victim.range.compare_exchange_weak(current, pack(next, middle),
+                                                   std::memory_order_acq_rel)) {
+                assign(middle, end);
+                return true;
+            }
+        }
+    }
+};
+
+/// @brief Evaluate chunks until no worker has any left
+void run_worker(size_t self, std::span<WorkRange> ranges,
+                std::span<Chunk> chunks) {
+    while (true) {
+        if (const std::optional<size_t> index = ranges[self].take()) {
+            Chunk &chunk = chunks[*index];
+            try {
+                chunk.output.reserve(chunk.input.size());
+                StringWriter writer{chunk.output};
+                chunk.stats = evaluate_range(chunk.input, writer);
+            } catch (...) {
+                chunk.error = std::current_exception();
+            }
+
+            chunk.done.store(true, std::memory_order_release);
+            chunk.done.notify_one();
+            continue;
+        }
+
+        // Chunks being moved between workers may be missed here, but the
+        // worker stealing them evaluates them
+        bool stolen = false;
+        for (size_t offset = 1; offset < ranges.size() && !stolen; offset++) {
+            WorkRange &victim = ranges[(self + offset) % ranges.size()];
+            stolen = ranges[self].steal_from(victim);
+        }
+
+        if (!stolen)
+            return;
+    }
+}
+
+} // namespace
+
+expression_evaluator::batch::BufferedWriter::~BufferedWriter() {
+    // Errors cannot be reported from a destructor; call flush() to see them
+    try {
+        flush();
+    } catch (const std::exception &) {
+    }
+}
+
+void expression_evaluator::batch::BufferedWriter::write(std::string_view text) {
+    if (text.size() > capacity - used) {
+        flush();
+
+        // Too large to be worth buffering
+        if (text.size() > capacity) {
+            if (std::fwrite(text.data(), 1, text.size(), stream) != text.size())
+                throw std::runtime_error("Cannot write output");
+            return;
+        }
+    }
+
+    std::memcpy(buffer.get() + used, text.data(), text.size());
+    used += text.size();
+}
+
+void expression_evaluator::batch::BufferedWriter::write(
+    const evaluator::Value &value) {
+    if (value.is_bool()) {
+        write(value.as_bool() ? std::string_view("true")
+                              : std::string_view("false"));
+        return;
+    }
+
+    char digits[NUMBER_DIGITS];
+    write(format_number(value.as_number(), digits));
+}
+
+void expression_evaluator::batch::BufferedWriter::flush() {
+    if (used != 0 && std::fwrite(buffer.get(), 1, used, stream) != used) {
+        used = 0;
+        throw std::runtime_error("Cannot write output");
+    }
+
+    used = 0;
+    if (std::fflush(stream) != 0)
+        throw std::runtime_error("Cannot write output");
+}
+
+expression_evaluator::Result<expression_evaluator::evaluator::Value>
+expression_evaluator::batch::try_evaluate_program(
+    const compiler::CompiledExpression &program, std::string_view line) {
+    if (program.get_variables().empty())
+        return program.try_evaluate();
+
+    // Variables take slots in order of first appearance, so the first
+    // identifier in the line is the first variable
+    lexer::Lexer lexer(line);
+    while (true) {
+        const Result<std::optional<Token>> next = lexer.try_next();
+        if (!next || !next.value())
+            break;
+        if (next.value()->type == TokenType::IDENTIFIER) {
+            const std::string_view name = next.value()->get_name();
+            return Error::with_text(
+                ErrorCode::UNBOUND_VARIABLE, name,
+                static_cast<std::uint32_t>(name.data() - line.data()));
+        }
+    }
+
+    // Not reached: the line was compiled, so it lexes up to its variables
+    return Error(ErrorCode::UNBOUND_VARIABLE);
+}
+
+expression_evaluator::Result<expression_evaluator::evaluator::Value>
+expression_evaluator::batch::try_evaluate_line(std::string_view line) {
+    const Result<compiler::CompiledExpression> program =
+        compiler::try_compile(line);
+    if (!program)
+        return program.get_error();
+
+    return try_evaluate_program(program.value(), line);
+}
+
+expression_evaluator::batch::BatchStats
+expression_evaluator::batch::evaluate_lines(std::string_view input,
+                                            BufferedWriter &output) {
+    return evaluate_range(input, output);
+}
+
+expression_evaluator::batch::BatchStats
+expression_evaluator::batch::evaluate_lines(std::string_view input,
+                                            BufferedWriter &output,
+                                            unsigned thread_count) {
+    if (thread_count == 0)
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::vector<std::string_view> inputs = split_chunks(input);
+    if (inputs.size() > UINT32_MAX)
+        throw std::runtime_error("Input too large");
+
+    const size_t worker_count =
+        std::min(static_cast<size_t>(thread_count), inputs.size());
+    if (worker_count <= 1)
+        return evaluate_range(input, output);
+
+    std::vector<Chunk> chunks(inputs.size());
+    for (size_t index = 0; index < inputs.size(); index++)
+        chunks[index].input = inputs[index];
+
+    // Each worker starts with an equal share of consecutive chunks
+    std::vector<WorkRange> ranges(worker_count);
+    for (size_t worker = 0; worker < worker_count; worker++)
+        ranges[worker].assign(chunks.size() * worker / worker_count,
+                              chunks.size() * (worker + 1) / worker_count);
+
+    BatchStats stats;
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(worker_count);
+        for (size_t worker = 0; worker < worker_count; worker++)
+            workers.emplace_back(run_worker, worker, std::span(ranges),
+                                 std::span(chunks));
+
+        // Write the chunks in input order as they complete; the workers are
+        // joined when leaving this scope, also if writing fails
+        for (Chunk &chunk : chunks) {
+            chunk.done.wait(false, std::memory_order_acquire);
+            if (chunk.error)
+                std::rethrow_exception(chunk.error);
+
+            output.write(chunk.output);
+            std::string().swap(chunk.output);
+            stats.lines += chunk.stats.lines;
+            stats.errors += chunk.stats.errors;
+        }
+    }
+
+    return stats;
+}
@@ -0,0 +1,65 @@
+#include <expression_evaluator/cache.hpp>
+#include <utility>
+
+namespace {
+using namespace expression_evaluator;
+
+/// @brief Estimate the heap and bookkeeping bytes of a cache entry: its text,
+/// its program's arrays, and the list and hash table nodes holding it
+size_t estimate_size(std::string_view text,
+                     const compiler::CompiledExpression &program) {
+    size_t size = text.size() + 4 * sizeof(void *) + sizeof(std::string) +
+                  sizeof(compiler::CompiledExpression) +
+                  program.get_code().size() * sizeof(compiler::Instruction) +
+                  program.get_constants().size() * sizeof(evaluator::Value);
+    for (const std::string &variable : program.get_variables())
+        size += sizeof(std::string) + variable.size();
+
+    return size;
+}
+} // namespace
+
+void expression_evaluator::cache::ExpressionCache::evict() {
+    while (memory_usage > memory_budget && entries.size() > 1) {
+        const Entry &entry = entries.back();
+        index.erase(entry.text);
+        memory_usage -= entry.size;
+        entries.pop_back();
+        stats.evictions++;
+    }
+}
+
+const compiler::CompiledExpression &
+expression_evaluator::cache::ExpressionCache::get(std::string_view expression) {
+    const auto found = index.find(expression);
+    if (found != index.end()) {
+        stats.hits++;
+        entries.splice(entries.begin(), entries, found->second);
+        return found->second->program;
+    }
+
+    stats.misses++;
+    compiler::CompiledExpression program =
+        compiler::optimize(compiler::compile(expression));
+
+    const size_t size = estimate_size(expression, program);
+    entries.push_front(
+        Entry{std::string(expression), std::move(program), size});
+    index.emplace(entries.front().text, entries.begin());
+    memory_usage += size;
+    evict();
+
+    return entries.front().program;
+}
+
+void expression_evaluator::cache::ExpressionCache::clear() noexcept {
+    index.clear();
+    entries.clear();
+    memory_usage = 0;
+}
+
+void expression_evaluator::cache::ExpressionCache::set_memory_budget(
+    size_t budget) {
+    memory_budget = budget;
+    evict();
+}
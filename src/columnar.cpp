@@ -0,0 +1,573 @@
+#include <algorithm>
+#include <expression_evaluator/columnar.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                              \
+    (defined(__GNUC__) || defined(__clang__))
+#define EXPRESSION_EVALUATOR_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace {
+using namespace expression_evaluator;
+using columnar::ColumnType;
+using columnar::KernelSet;
+using compiler::CompiledExpression;
+using compiler::OpCode;
+using evaluator::Value;
+
+// Number of rows each kernel processes per call. Small enough that the stack
+// of intermediate blocks stays in L1/L2 cache
+constexpr size_t BLOCK_SIZE = 512;
+
+[[noreturn]] void throw_division_by_zero() {
+    throw std::runtime_error("Math error: division by zero");
+}
+
+// Booleans are represented as exactly 1.0 or 0.0 in every kernel, so logical
+// operators can be implemented as bitwise operations on the doubles
+namespace scalar {
+void negate(const double *in, double *out, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        out[i] = -in[i];
+}
+
+void binary(OpCode op, const double *a, const double *b, double *out,
+            size_t n) {
+    switch (op) {
+    case OpCode::ADD:
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] + b[i];
+        break;
+    case OpCode::SUBTRACT:
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] - b[i];
+        break;
+    case OpCode::MULTIPLY:
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] * b[i];
+        break;
+    case OpCode::DIVIDE:
+        for (size_t i = 0; i < n; i++)
+            if (b[i] == 0.0)
+                throw_division_by_zero();
+
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] / b[i];
+        break;
+    case OpCode::POWER:
+        for (size_t i = 0; i < n; i++)
+            out[i] = evaluator::power(a[i], b[i]);
+        break;
+
+    case OpCode::EQUAL:
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] == b[i] ? 1.0 : 0.0;
+        break;
+    case OpCode::NOT_EQUAL:
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] != b[i] ? 1.0 : 0.0;
+        break;
+    case OpCode::GREATER:
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] > b[i] ? 1.0 : 0.0;
+        break;
+    case OpCode::LESS:
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] < b[i] ? 1.0 : 0.0;
+        break;
+    case OpCode::GREATER_EQUAL:
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] >= b[i] ? 1.0 : 0.0;
+        break;
+    case OpCode::LESS_EQUAL:
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] <= b[i] ? 1.0 : 0.0;
+        break;
+
+    case OpCode::AND:
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] != 0.0 && b[i] != 0.0 ? 1.0 : 0.0;
+        break;
+    case OpCode::OR:
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] != 0.0 || b[i] != 0.0 ? 1.0 : 0.0;
+        break;
+
+    default:
+        throw std::runtime_error("Unknown operator");
+    }
+}
+} // namespace scalar
+
+#ifdef EXPRESSION_EVALUATOR_X86_KERNELS
+// The vector kernels process as many full registers as fit in n, then hand
+// the remaining tail to the scalar kernels. There is no vector power, so POWER
+// runs entirely in the scalar tail
+namespace sse2 {
+__attribute__((target("sse2"))) void negate(const double *in, double *out,
+                                            size_t n) {
+    const __m128d sign = _mm_set1_pd(-0.0);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(out + i, _mm_xor_pd(_mm_loadu_pd(in + i), sign));
+
+    scalar::negate(in + i, out + i, n - i);
+}
+
+__attribute__((target("sse2"))) void
+binary(OpCode op, const double *a, const double *b, double *out, size_t n) {
+    const __m128d one = _mm_set1_pd(1.0);
+    size_t i = 0;
+
+    switch (op) {
+    case OpCode::ADD:
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(a + i),
+                                              _mm_loadu_pd(b + i)));
+        break;
+    case OpCode::SUBTRACT:
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_sub_pd(_mm_loadu_pd(a + i),
+                                              _mm_loadu_pd(b + i)));
+        break;
+    case OpCode::MULTIPLY:
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i),
+                                              _mm_loadu_pd(b + i)));
+        break;
+    case OpCode::DIVIDE: {
+        const __m128d zero = _mm_setzero_pd();
+        __m128d zero_divisors = _mm_setzero_pd();
+        for (; i + 2 <= n; i += 2) {
+            const __m128d divisor = _mm_loadu_pd(b + i);
+            zero_divisors =
+                _mm_or_pd(zero_divisors, _mm_cmpeq_pd(divisor, zero));
+            _mm_storeu_pd(out + i, _mm_div_pd(_mm_loadu_pd(a + i), divisor));
+        }
+
+        if (_mm_movemask_pd(zero_divisors) != 0)
+            throw_division_by_zero();
+        break;
+    }
+    case OpCode::POWER:
+        break;
+
+    case OpCode::EQUAL:
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i,
+                          _mm_and_pd(_mm_cmpeq_pd(_mm_loadu_pd(a + i),
+                                                  _mm_loadu_pd(b + i)),
+                                     one));
+        break;
+    case OpCode::NOT_EQUAL:
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i,
+                          _mm_and_pd(_mm_cmpneq_pd(_mm_loadu_pd(a + i),
+                                                   _mm_loadu_pd(b + i)),
+                                     one));
+        break;
+    case OpCode::GREATER:
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i,
+                          _mm_and_pd(_mm_cmpgt_pd(_mm_loadu_pd(a + i),
+                                                  _mm_loadu_pd(b + i)),
+                                     one));
+        break;
+    case OpCode::LESS:
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i,
+                          _mm_and_pd(_mm_cmplt_pd(_mm_loadu_pd(a + i),
+                                                  _mm_loadu_pd(b + i)),
+                                     one));
+        break;
+    case OpCode::GREATER_EQUAL:
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i,
+                          _mm_and_pd(_mm_cmpge_pd(_mm_loadu_pd(a + i),
+                                                  _mm_loadu_pd(b + i)),
+                                     one));
+        break;
+    case OpCode::LESS_EQUAL:
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i,
+                          _mm_and_pd(_mm_cmple_pd(_mm_loadu_pd(a + i),
+                                                  _mm_loadu_pd(b + i)),
+                                     one));
+        break;
+
+    case OpCode::AND:
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_and_pd(_mm_loadu_pd(a + i),
+                                              _mm_loadu_pd(b + i)));
+        break;
+    case OpCode::OR:
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_or_pd(_mm_loadu_pd(a + i),
+                                             _mm_loadu_pd(b + i)));
+        break;
+
+    default:
+        throw std::runtime_error("Unknown operator");
+    }
+
+    scalar::binary(op, a + i, b + i, out + i, n - i);
+}
+} // namespace sse2
+
+namespace avx2 {
+__attribute__((target("avx2"))) void negate(const double *in, double *out,
+                                            size_t n) {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(out + i,
+                         _mm256_xor_pd(_mm256_loadu_pd(in + i), sign));
+
+    scalar::negate(in + i, out + i, n - i);
+}
+
+// Ordered, non-signalling predicates match the C++ comparison operators on
+// NaN; NOT_EQUAL is unordered because NaN != NaN is true
+template <int Predicate>
+__attribute__((target("avx2"))) inline void
+compare(const double *a, const double *b, double *out, size_t &i, size_t n) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(
+            out + i, _mm256_and_pd(_mm256_cmp_pd(_mm256_loadu_pd(a + i),
+                                                 _mm256_loadu_pd(b + i),
+                                                 Predicate),
+                                   one));
+}
+
+__attribute__((target("avx2"))) void
+binary(OpCode op, const double *a, const double *b, double *out, size_t n) {
+    size_t i = 0;
+
+    switch (op) {
+    case OpCode::ADD:
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i),
+                                                    _mm256_loadu_pd(b + i)));
+        break;
+    case OpCode::SUBTRACT:
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(out + i, _mm256_sub_pd(_mm256_loadu_pd(a + i),
+                                                    _mm256_loadu_pd(b + i)));
+        break;
+    case OpCode::MULTIPLY:
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i),
+                                                    _mm256_loadu_pd(b + i)));
+        break;
+    case OpCode::DIVIDE: {
+        const __m256d zero = _mm256_setzero_pd();
+        __m256d zero_divisors = _mm256_setzero_pd();
+        for (; i + 4 <= n; i += 4) {
+            const __m256d divisor = _mm256_loadu_pd(b + i);
+            zero_divisors = _mm256_or_pd(
+                zero_divisors, _mm256_cmp_pd(divisor, zero, _CMP_EQ_OQ));
+            _mm256_storeu_pd(out + i,
+                             _mm256_div_pd(_mm256_loadu_pd(a + i), divisor));
+        }
+
+        if (_mm256_movemask_pd(zero_divisors) != 0)
+            throw_division_by_zero();
+        break;
+    }
+    case OpCode::POWER:
+        break;
+
+    case OpCode::EQUAL:
+        compare<_CMP_EQ_OQ>(a, b, out, i, n);
+        break;
+    case OpCode::NOT_EQUAL:
+        compare<_CMP_NEQ_UQ>(a, b, out, i, n);
+        break;
+    case OpCode::GREATER:
+        compare<_CMP_GT_OQ>(a, b, out, i, n);
+        break;
+    case OpCode::LESS:
+        compare<_CMP_LT_OQ>(a, b, out, i, n);
+        break;
+    case OpCode::GREATER_EQUAL:
+        compare<_CMP_GE_OQ>(a, b, out, i, n);
+        break;
+    case OpCode::LESS_EQUAL:
+        compare<_CMP_LE_OQ>(a, b, out, i, n);
+        break;
+
+    case OpCode::AND:
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(out + i, _mm256_and_pd(_mm256_loadu_pd(a + i),
+                                                    _mm256_loadu_pd(b + i)));
+        break;
+    case OpCode::OR:
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(out + i, _mm256_or_pd(_mm256_loadu_pd(a + i),
+                                                   _mm256_loadu_pd(b + i)));
+        break;
+
+    default:
+        throw std::runtime_error("Unknown operator");
+    }
+
+    scalar::binary(op, a + i, b + i, out + i, n - i);
+}
+} // namespace avx2
+#endif
+
+struct Kernels {
+    void (*negate)(const double *in, double *out, size_t n);
+    void (*binary)(OpCode op, const double *a, const double *b, double *out,
+                   size_t n);
+};
+
+Kernels select_kernels(KernelSet kernels) {
+    if (!columnar::is_supported(kernels))
+        throw std::runtime_error("Kernel set not supported by this CPU");
+
+    switch (kernels) {
+#ifdef EXPRESSION_EVALUATOR_X86_KERNELS
+    case KernelSet::SSE2:
+        return Kernels{sse2::negate, sse2::binary};
+    case KernelSet::AVX2:
+        return Kernels{avx2::negate, avx2::binary};
+#endif
+    default:
+        return Kernels{scalar::negate, scalar::binary};
+    }
+}
+
+/// @brief Infer the type of the program's result when every variable is a
+/// number
+/// @return false if some operator would raise a type error, or if a division
+/// is skipped by a short-circuit jump in some rows. In both cases the program
+/// has to be evaluated row by row to reproduce its errors
+bool infer_result_type(const CompiledExpression &program, ColumnType &result) {
+    const std::vector<compiler::Instruction> &code = program.get_code();
+    std::vector<ColumnType> types;
+    types.reserve(program.get_max_stack_depth());
+
+    // One past the last instruction that a jump seen so far may skip
+    size_t skipped_end = 0;
+
+    for (size_t index = 0; index < code.size(); index++) {
+        const compiler::Instruction &instruction = code[index];
+        switch (instruction.op) {
+        case OpCode::PUSH_CONSTANT: {
+            const Value &constant =
+                program.get_constants()[instruction.operand];
+            types.push_back(constant.is_bool() ? ColumnType::BOOLEAN
+                                               : ColumnType::NUMBER);
+            continue;
+        }
+        case OpCode::LOAD_VARIABLE:
+            types.push_back(ColumnType::NUMBER);
+            continue;
+        case OpCode::DUPLICATE:
+            types.push_back(types.back());
+            continue;
+        case OpCode::NEGATE:
+        case OpCode::REQUIRE_NUMBER:
+            if (types.back() != ColumnType::NUMBER)
+                return false;
+            continue;
+        case OpCode::REQUIRE_BOOL:
+            if (types.back() != ColumnType::BOOLEAN)
+                return false;
+            continue;
+        case OpCode::JUMP_IF_FALSE:
+        case OpCode::JUMP_IF_TRUE:
+            // Where the jump is not taken, the left operand is popped and
+            // the right one computes the result
+            if (types.back() != ColumnType::BOOLEAN)
+                return false;
+            types.pop_back();
+            skipped_end =
+                std::max(skipped_end, index + instruction.operand + 1);
+            continue;
+        case OpCode::DIVIDE:
+            if (index < skipped_end)
+                return false;
+            break;
+        default:
+            break;
+        }
+
+        const ColumnType right = types.back();
+        types.pop_back();
+        const ColumnType left = types.back();
+
+        switch (instruction.op) {
+        case OpCode::ADD:
+        case OpCode::SUBTRACT:
+        case OpCode::MULTIPLY:
+        case OpCode::DIVIDE:
+        case OpCode::POWER:
+            if (left != ColumnType::NUMBER || right != ColumnType::NUMBER)
+                return false;
+            break;
+        case OpCode::EQUAL:
+        case OpCode::NOT_EQUAL:
+            if (left != right)
+                return false;
+            types.back() = ColumnType::BOOLEAN;
+            break;
+        case OpCode::GREATER:
+        case OpCode::LESS:
+        case OpCode::GREATER_EQUAL:
+        case OpCode::LESS_EQUAL:
+            if (left != ColumnType::NUMBER || right != ColumnType::NUMBER)
+                return false;
+            types.back() = ColumnType::BOOLEAN;
+            break;
+        case OpCode::AND:
+        case OpCode::OR:
+            if (left != ColumnType::BOOLEAN || right != ColumnType::BOOLEAN)
+                return false;
+            break;
+        default:
+            throw std::runtime_error("Unknown operator");
+        }
+    }
+
+    result = types.back();
+    return true;
+}
+
+/// @brief Evaluate the program one row at a time, for programs whose type
+/// errors depend on row values
+ColumnType evaluate_rows(const CompiledExpression &program,
+                         std::span<const double *const> columns,
+                         size_t row_count, double *output) {
+    std::vector<Value> bindings(program.get_variables().size(), Value{0.0});
+    ColumnType type = ColumnType::NUMBER;
+
+    for (size_t row = 0; row < row_count; row++) {
+        for (size_t slot = 0; slot < bindings.size(); slot++)
+            bindings[slot] = Value{columns[slot][row]};
+
+        const Value result = program.evaluate(bindings);
+        if (result.is_bool()) {
+            type = ColumnType::BOOLEAN;
+            output[row] = result.as_bool() ? 1.0 : 0.0;
+        } else
+            output[row] = result.as_number();
+    }
+
+    return type;
+}
+} // namespace
+
+bool expression_evaluator::columnar::is_supported(KernelSet kernels) noexcept {
+    switch (kernels) {
+    case KernelSet::SCALAR:
+        return true;
+#ifdef EXPRESSION_EVALUATOR_X86_KERNELS
+    case KernelSet::SSE2:
+        return __builtin_cpu_supports("sse2");
+    case KernelSet::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+columnar::KernelSet expression_evaluator::columnar::best_kernel_set() noexcept {
+    if (is_supported(KernelSet::AVX2))
+        return KernelSet::AVX2;
+    else if (is_supported(KernelSet::SSE2))
+        return KernelSet::SSE2;
+
+    return KernelSet::SCALAR;
+}
+
+columnar::ColumnType expression_evaluator::columnar::evaluate(
+    const CompiledExpression &program, std::span<const double *const> columns,
+    size_t row_count, double *output, KernelSet kernels) {
+    const size_t variable_count = program.get_variables().size();
+    if (columns.size() < variable_count)
+        throw std::runtime_error("Missing variable columns: expected " +
+                                 std::to_string(variable_count) + ", got " +
+                                 std::to_string(columns.size()));
+
+    ColumnType result_type = ColumnType::NUMBER;
+    if (!infer_result_type(program, result_type))
+        return evaluate_rows(program, columns, row_count, output);
+
+    // Every row evaluates both operands of && and ||, which gives the same
+    // results once infer_result_type has ruled out errors in skipped code
+    const std::vector<compiler::Instruction> code =
+        compiler::remove_jumps(program.get_code());
+    const Kernels kernel = select_kernels(kernels);
+    const std::vector<Value> &constants = program.get_constants();
+    const size_t max_depth = program.get_max_stack_depth();
+
+    // Constants are broadcast into a block once, so every kernel can treat
+    // its operands as columns
+    std::vector<double> constant_blocks(constants.size() * BLOCK_SIZE);
+    for (size_t index = 0; index < constants.size(); index++) {
+        const Value &constant = constants[index];
+        const double value = constant.is_bool()
+                                 ? (constant.as_bool() ? 1.0 : 0.0)
+                                 : constant.as_number();
+        std::fill_n(constant_blocks.begin() +
+                        static_cast<std::ptrdiff_t>(index * BLOCK_SIZE),
+                    BLOCK_SIZE, value);
+    }
+
+    // Stack entry i points either at a variable column, at a constant block,
+    // or at scratch block i, which holds the result of an operator
+    std::vector<double> scratch(max_depth * BLOCK_SIZE);
+    std::vector<const double *> stack(max_depth);
+
+    for (size_t start = 0; start < row_count; start += BLOCK_SIZE) {
+        const size_t n = std::min(BLOCK_SIZE, row_count - start);
+        size_t top = 0;
+
+        for (const compiler::Instruction &instruction : code) {
+            switch (instruction.op) {
+            case OpCode::PUSH_CONSTANT:
+                stack[top++] =
+                    constant_blocks.data() + instruction.operand * BLOCK_SIZE;
+                break;
+            case OpCode::LOAD_VARIABLE:
+                stack[top++] = columns[instruction.operand] + start;
+                break;
+            case OpCode::DUPLICATE:
+                // Kernels read each element before writing it, so the copy
+                // can share the block
+                stack[top] = stack[top - 1];
+                top++;
+                break;
+            case OpCode::NEGATE: {
+                double *out = scratch.data() + (top - 1) * BLOCK_SIZE;
+                kernel.negate(stack[top - 1], out, n);
+                stack[top - 1] = out;
+                break;
+            }
+            case OpCode::REQUIRE_NUMBER:
+            case OpCode::REQUIRE_BOOL:
+                // Checked by infer_result_type
+                break;
+            default: {
+                double *out = scratch.data() + (top - 2) * BLOCK_SIZE;
+                kernel.binary(instruction.op, stack[top - 2], stack[top - 1],
+                              out, n);
+                stack[top - 2] = out;
+                top--;
+                break;
+            }
+            }
+        }
+
+        std::copy_n(stack[0], n, output + start);
+    }
+
+    return result_type;
+}
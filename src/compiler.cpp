@@ -0,0 +1,432 @@
+#include <cstdint>
+#include <expression_evaluator/compiler.hpp>
+#include <expression_evaluator/lexer.hpp>
+#include <expression_evaluator/parser.hpp>
+#include <expression_evaluator/stats.hpp>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+using namespace expression_evaluator;
+using compiler::Instruction;
+using compiler::OpCode;
+using evaluator::Value;
+
+OpCode to_opcode(TokenType type) {
+    switch (type) {
+    case TokenType::UNARY_MINUS:
+        return OpCode::NEGATE;
+    case TokenType::PLUS:
+        return OpCode::ADD;
+    case TokenType::MINUS:
+        return OpCode::SUBTRACT;
+    case TokenType::MULTIPLY:
+        return OpCode::MULTIPLY;
+    case TokenType::DIVIDE:
+        return OpCode::DIVIDE;
+    case TokenType::POWER:
+        return OpCode::POWER;
+    case TokenType::EQUAL:
+        return OpCode::EQUAL;
+    case TokenType::NOT_EQUAL:
+        return OpCode::NOT_EQUAL;
+    case TokenType::GREATER:
+        return OpCode::GREATER;
+    case TokenType::LESS:
+        return OpCode::LESS;
+    case TokenType::GREATER_EQUAL:
+        return OpCode::GREATER_EQUAL;
+    case TokenType::LESS_EQUAL:
+        return OpCode::LESS_EQUAL;
+    case TokenType::AND:
+        return OpCode::AND;
+    case TokenType::OR:
+        return OpCode::OR;
+    default:
+        throw std::runtime_error("Unknown operator");
+    }
+}
+
+Value to_value(const Token &token) {
+    switch (token.type) {
+    case TokenType::INTEGER:
+        return Value{static_cast<double>(token.get_integer())};
+    case TokenType::FLOAT:
+        return Value{token.get_float()};
+    case TokenType::TRUE:
+        return Value{true};
+    case TokenType::FALSE:
+        return Value{false};
+    default:
+        throw std::runtime_error("Unknown literal");
+    }
+}
+
+/// @brief Compare two values for equality, requiring matching types
+/// @throws std::runtime_error if the operand types differ
+bool values_equal(const Value &left, const Value &right) {
+    if (left.is_number() && right.is_number())
+        return left.as_number() == right.as_number();
+    else if (left.is_bool() && right.is_bool())
+        return left.as_bool() == right.as_bool();
+
+    throw std::runtime_error("Type error: type mismatch in comparison");
+}
+
+/// @brief Return the slot of a variable, assigning a new one if the layout is
+/// not fixed
+/// @return The slot, or std::nullopt if the layout is fixed and does not
+/// contain the name
+std::optional<std::uint32_t>
+resolve_variable(std::string_view name, std::vector<std::string> &variables,
+                 bool fixed_layout) {
+    for (size_t slot = 0; slot < variables.size(); slot++)
+        if (variables[slot] == name)
+            return static_cast<std::uint32_t>(slot);
+
+    if (fixed_layout)
+        return std::nullopt;
+
+    variables.emplace_back(name);
+    return static_cast<std::uint32_t>(variables.size() - 1);
+}
+
+/// @brief Apply a binary operator to the two integers on top of the stack, if
+/// both operands are, see evaluator::apply_integers()
+/// @param depth The stack depth once the operator has been applied
+/// @param integers The integers on the stack, as their depth and value. The
+/// operands' entries are removed, and an integer result is added
+/// @return The result, or std::nullopt if the operator must be emitted
+std::optional<Value>
+apply_exact(TokenType op, size_t depth,
+            std::vector<std::pair<size_t, std::int64_t>> &integers) {
+    const size_t count = integers.size();
+    if (count < 2 || integers[count - 1].first != depth + 1 ||
+        integers[count - 2].first != depth) {
+        while (!integers.empty() && integers.back().first >= depth)
+            integers.pop_back();
+        return std::nullopt;
+    }
+
+    const std::int64_t left = integers[count - 2].second;
+    const std::int64_t right = integers[count - 1].second;
+    integers.resize(count - 2);
+    if (const std::optional<bool> compared =
+            evaluator::compare_integers(op, left, right))
+        return Value{*compared};
+
+    const std::optional<std::int64_t> result =
+        evaluator::apply_integers(op, left, right);
+    if (!result)
+        return std::nullopt;
+
+    integers.emplace_back(depth, *result);
+    return Value{static_cast<double>(*result)};
+}
+
+/// @brief Lex, parse and flatten an expression into straight-line code, see
+/// compiler::try_compile
+/// @return The first error, if any
+Result<void> flatten(std::string_view expression,
+                     std::vector<std::string> &variables, bool fixed_layout,
+                     std::vector<Instruction> &code,
+                     std::vector<Value> &constants, size_t &max_depth) {
+    TokenQueue infix_queue;
+    if (Result<void> lexed = lexer::try_tokenize(expression, infix_queue);
+        !lexed)
+        return lexed.get_error();
+
+    TokenQueue postfix_queue;
+    if (Result<void> parsed =
+            parser::try_to_postfix(infix_queue, postfix_queue);
+        !parsed)
+        return parsed.get_error();
+
+    code.reserve(postfix_queue.size());
+
+    // Track the stack depth while flattening so that operand count errors are
+    // reported here once, rather than on every evaluation
+    size_t depth = 0;
+    // Integer literals and the results computed from them, as their stack
+    // depth and exact value. Each is the last constant pushed at that depth,
+    // so operators between them are applied in int64 here, see
+    // evaluator::apply_integers()
+    std::vector<std::pair<size_t, std::int64_t>> integers;
+    while (!postfix_queue.is_empty()) {
+        Token token = postfix_queue.dequeue();
+
+        if (token.is_literal()) {
+            code.push_back(Instruction{
+                OpCode::PUSH_CONSTANT,
+                static_cast<std::uint32_t>(constants.size())});
+            constants.push_back(to_value(token));
+            depth++;
+            if (token.type == TokenType::INTEGER)
+                integers.emplace_back(depth, token.get_integer());
+        } else if (token.type == TokenType::IDENTIFIER) {
+            const std::string_view name = token.get_name();
+            const std::optional<std::uint32_t> slot =
+                resolve_variable(name, variables, fixed_layout);
+            if (!slot) {
+                const auto offset =
+                    static_cast<std::uint32_t>(name.data() - expression.data());
+                return Error::with_text(ErrorCode::UNKNOWN_VARIABLE, name,
+                                        offset);
+            }
+
+            code.push_back(Instruction{OpCode::LOAD_VARIABLE, *slot});
+            depth++;
+        } else if (token.type == TokenType::UNARY_MINUS) {
+            if (depth < 1)
+                return Error(ErrorCode::MISSING_OPERAND,
+                             token.get_source_offset());
+
+            if (!integers.empty() && integers.back().first == depth) {
+                if (const std::optional<std::int64_t> negated =
+                        evaluator::negate_integer(integers.back().second)) {
+                    integers.back().second = *negated;
+                    constants.back() = Value{static_cast<double>(*negated)};
+                    continue;
+                }
+                integers.pop_back();
+            }
+
+            code.push_back(Instruction{OpCode::NEGATE, 0});
+        } else {
+            if (depth < 2)
+                return Error(ErrorCode::INSUFFICIENT_OPERANDS,
+                             token.get_source_offset());
+
+            depth--;
+            if (std::optional<Value> exact =
+                    apply_exact(token.type, depth, integers)) {
+                code.pop_back();
+                constants.pop_back();
+                constants.back() = *exact;
+                continue;
+            }
+
+            code.push_back(Instruction{to_opcode(token.type), 0});
+        }
+    }
+
+    if (depth != 1)
+        return Error(ErrorCode::TOO_MANY_OPERANDS);
+
+    // Integers combined above took more stack than their result does, so
+    // the depth is measured on the code as emitted
+    depth = 0;
+    for (const Instruction &instruction : code) {
+        if (instruction.op == OpCode::PUSH_CONSTANT ||
+            instruction.op == OpCode::LOAD_VARIABLE)
+            depth++;
+        else if (instruction.op != OpCode::NEGATE)
+            depth--;
+
+        if (depth > max_depth)
+            max_depth = depth;
+    }
+
+    return {};
+}
+} // namespace
+
+compiler::CompiledExpression
+expression_evaluator::compiler::compile(std::string_view expression) {
+    return try_compile(expression).value();
+}
+
+compiler::CompiledExpression expression_evaluator::compiler::compile(
+    std::string_view expression,
+    std::span<const std::string_view> variable_names) {
+    return try_compile(expression, variable_names).value();
+}
+
+Result<compiler::CompiledExpression>
+expression_evaluator::compiler::try_compile(std::string_view expression) {
+    stats::detail::StageTimer timer(stats::Stage::COMPILE);
+    std::vector<std::string> variables;
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    size_t max_depth = 0;
+    if (Result<void> flattened = flatten(expression, variables, false, code,
+                                         constants, max_depth);
+        !flattened) {
+        timer.fail();
+        return flattened.get_error();
+    }
+
+    return CompiledExpression{insert_jumps(code), std::move(constants),
+                              std::move(variables), max_depth};
+}
+
+Result<compiler::CompiledExpression>
+expression_evaluator::compiler::try_compile(
+    std::string_view expression,
+    std::span<const std::string_view> variable_names) {
+    stats::detail::StageTimer timer(stats::Stage::COMPILE);
+    std::vector<std::string> variables(variable_names.begin(),
+                                       variable_names.end());
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    size_t max_depth = 0;
+    if (Result<void> flattened = flatten(expression, variables, true, code,
+                                         constants, max_depth);
+        !flattened) {
+        timer.fail();
+        return flattened.get_error();
+    }
+
+    return CompiledExpression{insert_jumps(code), std::move(constants),
+                              std::move(variables), max_depth};
+}
+
+std::vector<Instruction> expression_evaluator::compiler::insert_jumps(
+    std::span<const Instruction> code) {
+    constexpr size_t NO_JUMP = SIZE_MAX;
+
+    // For each instruction starting the right operand of an AND or OR, the
+    // index of that operator. No two operators have right operands starting
+    // at the same instruction, so there is at most one jump per position
+    std::vector<size_t> operator_index(code.size(), NO_JUMP);
+    std::vector<size_t> starts;
+    for (size_t index = 0; index < code.size(); index++) {
+        switch (code[index].op) {
+        case OpCode::PUSH_CONSTANT:
+        case OpCode::LOAD_VARIABLE:
+        case OpCode::DUPLICATE:
+            starts.push_back(index);
+            break;
+        case OpCode::NEGATE:
+        case OpCode::REQUIRE_NUMBER:
+        case OpCode::REQUIRE_BOOL:
+            break;
+        default:
+            if (code[index].op == OpCode::AND || code[index].op == OpCode::OR)
+                operator_index[starts.back()] = index;
+            starts.pop_back();
+            break;
+        }
+    }
+
+    // Position of each instruction once the jumps are in place
+    std::vector<size_t> positions(code.size());
+    size_t position = 0;
+    for (size_t index = 0; index < code.size(); index++) {
+        if (operator_index[index] != NO_JUMP)
+            position++;
+        positions[index] = position++;
+    }
+
+    std::vector<Instruction> result;
+    result.reserve(position);
+    for (size_t index = 0; index < code.size(); index++) {
+        if (const size_t op_index = operator_index[index]; op_index != NO_JUMP)
+            // Skip the right operand and the REQUIRE_BOOL replacing the
+            // operator
+            result.push_back(Instruction{
+                code[op_index].op == OpCode::AND ? OpCode::JUMP_IF_FALSE
+                                                 : OpCode::JUMP_IF_TRUE,
+                static_cast<std::uint32_t>(positions[op_index] -
+                                           positions[index] + 1)});
+
+        if (code[index].op == OpCode::AND || code[index].op == OpCode::OR)
+            result.push_back(Instruction{OpCode::REQUIRE_BOOL, 0});
+        else
+            result.push_back(code[index]);
+    }
+
+    return result;
+}
+
+std::vector<Instruction> expression_evaluator::compiler::remove_jumps(
+    std::span<const Instruction> code) {
+    std::vector<Instruction> straight(code.begin(), code.end());
+    size_t jump_count = 0;
+    for (size_t index = 0; index < code.size(); index++) {
+        const OpCode op = code[index].op;
+        if (op != OpCode::JUMP_IF_FALSE && op != OpCode::JUMP_IF_TRUE)
+            continue;
+
+        // The last skipped instruction is the REQUIRE_BOOL replacing the
+        // operator
+        straight[index + code[index].operand].op =
+            op == OpCode::JUMP_IF_FALSE ? OpCode::AND : OpCode::OR;
+        jump_count++;
+    }
+
+    std::vector<Instruction> result;
+    result.reserve(code.size() - jump_count);
+    for (const Instruction &instruction : straight)
+        if (instruction.op != OpCode::JUMP_IF_FALSE &&
+            instruction.op != OpCode::JUMP_IF_TRUE)
+            result.push_back(instruction);
+
+    return result;
+}
+
+evaluator::Value
+expression_evaluator::compiler::apply_unary(OpCode op, const Value &operand) {
+    using evaluator::require_bool;
+    using evaluator::require_number;
+
+    switch (op) {
+    case OpCode::NEGATE:
+        return Value{-require_number(operand)};
+    case OpCode::REQUIRE_NUMBER:
+        (void)require_number(operand);
+        return operand;
+    case OpCode::REQUIRE_BOOL:
+        (void)require_bool(operand);
+        return operand;
+    default:
+        throw std::runtime_error("Unknown operator");
+    }
+}
+
+evaluator::Value expression_evaluator::compiler::apply_binary(
+    OpCode op, const Value &left, const Value &right) {
+    using evaluator::require_bool;
+    using evaluator::require_number;
+
+    switch (op) {
+    case OpCode::ADD:
+        return Value{require_number(left) + require_number(right)};
+    case OpCode::SUBTRACT:
+        return Value{require_number(left) - require_number(right)};
+    case OpCode::MULTIPLY:
+        return Value{require_number(left) * require_number(right)};
+    case OpCode::DIVIDE: {
+        const double right_number = require_number(right);
+        if (right_number == 0.0)
+            throw std::runtime_error("Math error: division by zero");
+
+        return Value{require_number(left) / right_number};
+    }
+    case OpCode::POWER:
+        return Value{
+            evaluator::power(require_number(left), require_number(right))};
+
+    case OpCode::EQUAL:
+        return Value{values_equal(left, right)};
+    case OpCode::NOT_EQUAL:
+        return Value{!values_equal(left, right)};
+    case OpCode::GREATER:
+        return Value{require_number(left) > require_number(right)};
+    case OpCode::LESS:
+        return Value{require_number(left) < require_number(right)};
+    case OpCode::GREATER_EQUAL:
+        return Value{require_number(left) >= require_number(right)};
+    case OpCode::LESS_EQUAL:
+        return Value{require_number(left) <= require_number(right)};
+
+    case OpCode::AND:
+        return Value{require_bool(left) && require_bool(right)};
+    case OpCode::OR:
+        return Value{require_bool(left) || require_bool(right)};
+
+    default:
+        throw std::runtime_error("Unknown operator");
+    }
+}
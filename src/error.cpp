@@ -0,0 +1,87 @@
+#include <expression_evaluator/error.hpp>
+#include <expression_evaluator/evaluator.hpp>
+#include <expression_evaluator/stats.hpp>
+#include <stdexcept>
+
+namespace {
+using namespace expression_evaluator;
+} // namespace
+
+Error expression_evaluator::Error::expected_number(
+    bool operand, std::uint32_t source_offset) noexcept {
+    Error error(ErrorCode::EXPECTED_NUMBER, source_offset);
+    error.operand = operand ? 1.0 : 0.0;
+    return error;
+}
+
+Error expression_evaluator::Error::expected_boolean(
+    double operand, std::uint32_t source_offset) noexcept {
+    Error error(ErrorCode::EXPECTED_BOOLEAN, source_offset);
+    error.operand = operand;
+    return error;
+}
+
+Error expression_evaluator::Error::with_text(
+    ErrorCode code, std::string_view text,
+    std::uint32_t source_offset) noexcept {
+    Error error(code, source_offset);
+    error.text = text;
+    return error;
+}
+
+Error expression_evaluator::Error::missing_bindings(size_t expected,
+                                                    size_t supplied) noexcept {
+    Error error(ErrorCode::MISSING_BINDINGS);
+    error.expected = expected;
+    error.supplied = supplied;
+    return error;
+}
+
+std::string expression_evaluator::Error::message() const {
+    using evaluator::Value;
+
+    switch (code) {
+    case ErrorCode::EXPECTED_NUMBER:
+        return "Type error: Expected number, got boolean '" +
+               Value{operand != 0.0}.to_string() + "'";
+    case ErrorCode::EXPECTED_BOOLEAN:
+        return "Type error: Expected boolean, got number '" +
+               Value{operand}.to_string() + "'";
+    case ErrorCode::TYPE_MISMATCH:
+        return "Type error: type mismatch in comparison";
+    case ErrorCode::DIVISION_BY_ZERO:
+        return "Math error: division by zero";
+    case ErrorCode::MISSING_OPERAND:
+        return "Invalid expression: missing operand";
+    case ErrorCode::INSUFFICIENT_OPERANDS:
+        return "Invalid expression: insufficient operands";
+    case ErrorCode::TOO_MANY_OPERANDS:
+        return "Syntax error: too many operands";
+    case ErrorCode::MISMATCHED_PARENTHESES:
+        return "Syntax error: mismatched parentheses";
+    case ErrorCode::MULTIPLE_DECIMAL_POINTS:
+        return "Invalid number: multiple decimal points";
+    case ErrorCode::INVALID_NUMBER:
+        return "Invalid number: " + std::string(text);
+    case ErrorCode::UNEXPECTED_CHARACTER:
+        return "Unexpected character: '" + std::string(text) + "'";
+    case ErrorCode::EXPRESSION_TOO_LONG:
+        return "Expression too long";
+    case ErrorCode::UNBOUND_VARIABLE:
+        return "Unbound variable: " + std::string(text);
+    case ErrorCode::UNKNOWN_VARIABLE:
+        return "Unknown variable: " + std::string(text);
+    case ErrorCode::MISSING_BINDINGS:
+        return "Missing variable bindings: expected " +
+               std::to_string(expected) + ", got " + std::to_string(supplied);
+    case ErrorCode::CIRCULAR_REFERENCE:
+        return "Circular reference: " + std::string(text);
+    default:
+        return "Unknown operator";
+    }
+}
+
+void expression_evaluator::Error::raise() const {
+    stats::detail::note_exception();
+    throw std::runtime_error(message());
+}
@@ -1,154 +1,269 @@
-#include <cmath>
+#include <cstdint>
 #include <expression_evaluator/evaluator.hpp>
-#include <expression_evaluator/structures/stack.hpp>
-#include <stdexcept>
+#include <expression_evaluator/lexer.hpp>
+#include <expression_evaluator/parser.hpp>
+#include <expression_evaluator/stats.hpp>
+#include <optional>
 
 namespace {
 using namespace expression_evaluator;
+using evaluator::Value;
 
-/// @brief Ensure the operand is a number and return it, or throw an error
-/// @throws std::runtime_error if the value is not a number
-double require_number(const evaluator::Value &val) {
-    if (val.is_number())
-        return val.as_number();
+/// @brief The type error of an operand that should have been a number
+Error not_a_number(const Value &value, std::uint32_t source_offset) {
+    return Error::expected_number(value.as_bool(), source_offset);
+}
 
-    throw std::runtime_error("Type error: Expected number, got boolean '" +
-                             val.to_string() + "'");
+/// @brief The type error of an operand that should have been a boolean
+Error not_a_boolean(const Value &value, std::uint32_t source_offset) {
+    return Error::expected_boolean(value.as_number(), source_offset);
 }
+} // namespace
 
-/// @brief Ensure the operand is a boolean and return it, or throw an error
-/// @throws std::runtime_error if the value is not a boolean
-bool require_bool(const evaluator::Value &val) {
-    if (val.is_bool())
-        return val.as_bool();
+double evaluator::require_number(const Value &val) {
+    if (!val.is_number())
+        Error::expected_number(val.as_bool()).raise();
 
-    throw std::runtime_error("Type error: Expected boolean, got number '" +
-                             val.to_string() + "'");
+    return val.as_number();
 }
 
-} // namespace
+bool evaluator::require_bool(const Value &val) {
+    if (!val.is_bool())
+        Error::expected_boolean(val.as_number()).raise();
 
-evaluator::Value expression_evaluator::evaluator::evaluate_expression(
-    structures::Queue<Token> &postfix_queue) {
-    structures::Stack<Value> value_stack;
+    return val.as_bool();
+}
 
-    while (!postfix_queue.is_empty()) {
-        Token token = postfix_queue.dequeue();
-
-        // Push operands directly onto stack
-        if (token.type == TokenType::INTEGER)
-            value_stack.push(Value{std::get<int>(token.value)});
-        else if (token.type == TokenType::FLOAT)
-            value_stack.push(Value{std::get<double>(token.value)});
-        else if (token.type == TokenType::TRUE)
-            value_stack.push(Value{true});
-        else if (token.type == TokenType::FALSE)
-            value_stack.push(Value{false});
-
-        // Unary operators
-        else if (token.type == TokenType::UNARY_MINUS) {
-            if (value_stack.is_empty())
-                throw std::runtime_error("Invalid expression: missing operand");
-
-            Value operand = value_stack.pop();
-            value_stack.push(Value{-require_number(operand)});
-        }
-        // Binary operators
-        else {
-            if (value_stack.size() < 2)
-                throw std::runtime_error(
-                    "Invalid expression: insufficient operands");
-
-            Value right = value_stack.pop();
-            Value left = value_stack.pop();
-
-            switch (token.type) {
-            // Arithmetic operators
-            case TokenType::PLUS:
-                value_stack.push(
-                    Value{require_number(left) + require_number(right)});
-                break;
-            case TokenType::MINUS:
-                value_stack.push(
-                    Value{require_number(left) - require_number(right)});
-                break;
-            case TokenType::MULTIPLY:
+Result<void> expression_evaluator::evaluator::StackEvaluator::try_apply(
+    const Token &token) {
+    // Push operands directly onto stack
+    if (token.type == TokenType::INTEGER) {
+        const std::int64_t integer = token.get_integer();
+        value_stack.push(Operand{Value{static_cast<double>(integer)}, integer});
+        return {};
+    } else if (token.type == TokenType::FLOAT) {
+        value_stack.push(Value{token.get_float()});
+        return {};
+    } else if (token.type == TokenType::TRUE) {
+        value_stack.push(Value{true});
+        return {};
+    } else if (token.type == TokenType::FALSE) {
+        value_stack.push(Value{false});
+        return {};
+    } else if (token.type == TokenType::IDENTIFIER) {
+        // Names point into the expression, when it is known
+        const std::string_view name = token.get_name();
+        const std::uint32_t source_offset =
+            expression.empty()
+                ? Error::NO_SOURCE_OFFSET
+                : static_cast<std::uint32_t>(name.data() - expression.data());
+        return Error::with_text(ErrorCode::UNBOUND_VARIABLE, name,
+                                source_offset);
+    }
+
+    const std::uint32_t source_offset = token.get_source_offset();
+
+    // Unary operators
+    if (token.type == TokenType::UNARY_MINUS) {
+        if (value_stack.is_empty())
+            return Error(ErrorCode::MISSING_OPERAND, source_offset);
+
+        const Operand operand = value_stack.pop();
+        if (operand.integer) {
+            if (const std::optional<std::int64_t> negated =
+                    negate_integer(*operand.integer)) {
                 value_stack.push(
-                    Value{require_number(left) * require_number(right)});
-                break;
-            case TokenType::DIVIDE: {
-                const double right_number = require_number(right);
-                if (right_number == 0.0)
-                    throw std::runtime_error("Math error: division by zero");
-
-                value_stack.push(Value{require_number(left) / right_number});
-                break;
+                    Operand{Value{static_cast<double>(*negated)}, *negated});
+                return {};
             }
-            case TokenType::POWER:
-                value_stack.push(Value{
-                    std::pow(require_number(left), require_number(right))});
-                break;
-
-            // Comparison operators
-            case TokenType::EQUAL:
-                if (left.is_number() && right.is_number())
-                    value_stack.push(
-                        Value{require_number(left) == require_number(right)});
-                else if (left.is_bool() && right.is_bool())
-                    value_stack.push(
-                        Value{require_bool(left) == require_bool(right)});
-                else
-                    throw std::runtime_error(
-                        "Type error: type mismatch in comparison");
-
-                break;
-            case TokenType::NOT_EQUAL:
-                if (left.is_number() && right.is_number())
-                    value_stack.push(
-                        Value{require_number(left) != require_number(right)});
-                else if (left.is_bool() && right.is_bool())
-                    value_stack.push(
-                        Value{require_bool(left) != require_bool(right)});
-                else
-                    throw std::runtime_error(
-                        "Type error: type mismatch in comparison");
-
-                break;
-            case TokenType::GREATER:
-                value_stack.push(
-                    Value{require_number(left) > require_number(right)});
-                break;
-            case TokenType::LESS:
-                value_stack.push(
-                    Value{require_number(left) < require_number(right)});
-                break;
-            case TokenType::GREATER_EQUAL:
-                value_stack.push(
-                    Value{require_number(left) >= require_number(right)});
-                break;
-            case TokenType::LESS_EQUAL:
-                value_stack.push(
-                    Value{require_number(left) <= require_number(right)});
-                break;
+        }
 
-            // Logical operators
-            case TokenType::AND:
-                value_stack.push(
-                    Value{require_bool(left) && require_bool(right)});
-                break;
-            case TokenType::OR:
-                value_stack.push(
-                    Value{require_bool(left) || require_bool(right)});
-                break;
+        if (!operand.value.is_number())
+            return not_a_number(operand.value, source_offset);
 
-            default:
-                throw std::runtime_error("Unknown operator");
-            }
+        value_stack.push(Value{-operand.value.as_number()});
+        return {};
+    }
+
+    // Binary operators
+    if (value_stack.size() < 2)
+        return Error(ErrorCode::INSUFFICIENT_OPERANDS, source_offset);
+
+    const Operand right_operand = value_stack.pop();
+    const Operand left_operand = value_stack.pop();
+
+    // Integers stay exact until an operator needs a double
+    if (left_operand.integer && right_operand.integer) {
+        const std::int64_t left_integer = *left_operand.integer;
+        const std::int64_t right_integer = *right_operand.integer;
+        if (const std::optional<bool> compared =
+                compare_integers(token.type, left_integer, right_integer)) {
+            value_stack.push(Value{*compared});
+            return {};
+        }
+        if (const std::optional<std::int64_t> result =
+                apply_integers(token.type, left_integer, right_integer)) {
+            value_stack.push(
+                Operand{Value{static_cast<double>(*result)}, *result});
+            return {};
         }
     }
 
+    const Value right = right_operand.value;
+    const Value left = left_operand.value;
+
+    switch (token.type) {
+    // Equality compares two values of the same type
+    case TokenType::EQUAL:
+    case TokenType::NOT_EQUAL: {
+        if (left.is_number() != right.is_number())
+            return Error(ErrorCode::TYPE_MISMATCH, source_offset);
+
+        const bool equal = left.is_number()
+                               ? left.as_number() == right.as_number()
+                               : left.as_bool() == right.as_bool();
+        value_stack.push(Value{equal == (token.type == TokenType::EQUAL)});
+        return {};
+    }
+
+    // Logical operators. The right operand is not checked when the left one
+    // decides the result
+    case TokenType::AND:
+    case TokenType::OR: {
+        if (!left.is_bool())
+            return not_a_boolean(left, source_offset);
+
+        const bool decided = left.as_bool() == (token.type == TokenType::OR);
+        if (!decided && !right.is_bool())
+            return not_a_boolean(right, source_offset);
+
+        value_stack.push(decided ? left : right);
+        return {};
+    }
+
+    // The divisor is checked before the dividend
+    case TokenType::DIVIDE:
+        if (!right.is_number())
+            return not_a_number(right, source_offset);
+        if (right.as_number() == 0.0)
+            return Error(ErrorCode::DIVISION_BY_ZERO, source_offset);
+        break;
+
+    default:
+        break;
+    }
+
+    // The remaining operators take two numbers
+    if (!left.is_number())
+        return not_a_number(left, source_offset);
+    if (!right.is_number())
+        return not_a_number(right, source_offset);
+
+    const double left_number = left.as_number();
+    const double right_number = right.as_number();
+    switch (token.type) {
+    // Arithmetic operators
+    case TokenType::PLUS:
+        value_stack.push(Value{left_number + right_number});
+        break;
+    case TokenType::MINUS:
+        value_stack.push(Value{left_number - right_number});
+        break;
+    case TokenType::MULTIPLY:
+        value_stack.push(Value{left_number * right_number});
+        break;
+    case TokenType::DIVIDE:
+        value_stack.push(Value{left_number / right_number});
+        break;
+    case TokenType::POWER:
+        value_stack.push(Value{power(left_number, right_number)});
+        break;
+
+    // Comparison operators
+    case TokenType::GREATER:
+        value_stack.push(Value{left_number > right_number});
+        break;
+    case TokenType::LESS:
+        value_stack.push(Value{left_number < right_number});
+        break;
+    case TokenType::GREATER_EQUAL:
+        value_stack.push(Value{left_number >= right_number});
+        break;
+    case TokenType::LESS_EQUAL:
+        value_stack.push(Value{left_number <= right_number});
+        break;
+
+    default:
+        return Error(ErrorCode::UNKNOWN_OPERATOR, source_offset);
+    }
+
+    return {};
+}
+
+Result<evaluator::Value>
+expression_evaluator::evaluator::StackEvaluator::try_result() {
     if (value_stack.size() != 1)
-        throw std::runtime_error("Syntax error: too many operands");
+        return Error(ErrorCode::TOO_MANY_OPERANDS);
+
+    return value_stack.pop().value;
+}
+
+Result<evaluator::Value>
+expression_evaluator::evaluator::try_evaluate_expression(
+    TokenQueue &postfix_queue) {
+    stats::detail::StageTimer timer(stats::Stage::EVALUATE_POSTFIX);
+    StackEvaluator stack_evaluator;
+    while (!postfix_queue.is_empty()) {
+        timer.add_tokens(1);
+        if (Result<void> applied =
+                stack_evaluator.try_apply(postfix_queue.dequeue());
+            !applied) {
+            timer.fail();
+            return applied.get_error();
+        }
+    }
+
+    Result<Value> result = stack_evaluator.try_result();
+    if (!result)
+        timer.fail();
+    return result;
+}
+
+evaluator::Value expression_evaluator::evaluator::evaluate_expression(
+    TokenQueue &postfix_queue) {
+    return try_evaluate_expression(postfix_queue).value();
+}
+
+Result<evaluator::Value>
+expression_evaluator::evaluator::try_evaluate(std::string_view expression) {
+    stats::detail::StageTimer timer(stats::Stage::EVALUATE);
+    lexer::Lexer lexer(expression);
+    parser::PostfixStream<lexer::Lexer> postfix(lexer);
 
-    return value_stack.pop();
-}
\ No newline at end of file
+    StackEvaluator stack_evaluator(expression);
+    while (true) {
+        Result<std::optional<Token>> token = postfix.try_next();
+        if (!token) {
+            timer.fail();
+            return token.get_error();
+        }
+        if (!token.value()) {
+            Result<Value> result = stack_evaluator.try_result();
+            if (!result)
+                timer.fail();
+            return result;
+        }
+
+        timer.add_tokens(1);
+        if (Result<void> applied = stack_evaluator.try_apply(*token.value());
+            !applied) {
+            timer.fail();
+            return applied.get_error();
+        }
+    }
+}
+
+evaluator::Value
+expression_evaluator::evaluator::evaluate(std::string_view expression) {
+    return try_evaluate(expression).value();
+}
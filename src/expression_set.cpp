@@ -0,0 +1,293 @@
+#include <bit>
+#include <cstdint>
+#include <expression_evaluator/expression_set.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+using namespace expression_evaluator;
+using compiler::OpCode;
+using evaluator::Value;
+
+/// @brief The values of one evaluation's nodes. A node that failed has the
+/// index of its error plus one in failures; the others have 0, which is
+/// restored after each evaluation so that only failed nodes are touched
+struct Scratch {
+    std::vector<Value> values;
+    std::vector<std::uint32_t> failures;
+    std::vector<std::uint32_t> failed_nodes;
+    std::vector<Error> errors;
+
+    void resize(size_t node_count) {
+        if (values.size() < node_count) {
+            values.resize(node_count, Value{0.0});
+            failures.resize(node_count, 0);
+        }
+    }
+
+    void fail(std::uint32_t node, std::uint32_t failure) {
+        failures[node] = failure;
+        failed_nodes.push_back(node);
+    }
+
+    void fail(std::uint32_t node, const Error &error) {
+        errors.push_back(error);
+        fail(node, static_cast<std::uint32_t>(errors.size()));
+    }
+
+    void reset() {
+        for (const std::uint32_t node : failed_nodes)
+            failures[node] = 0;
+        failed_nodes.clear();
+        errors.clear();
+    }
+};
+
+thread_local Scratch scratch;
+
+/// @brief Apply an operator whose operands did not fail, with the checks of
+/// the interpreter
+/// @return false if a check failed
+bool apply(OpCode op, Value left, Value right, Value &result) {
+    const bool numbers = left.is_number() && right.is_number();
+    switch (op) {
+    case OpCode::NEGATE:
+        result = Value{-left.as_number()};
+        return left.is_number();
+    case OpCode::REQUIRE_NUMBER:
+        result = left;
+        return left.is_number();
+    case OpCode::REQUIRE_BOOL:
+        result = left;
+        return left.is_bool();
+
+    case OpCode::ADD:
+        result = Value{left.as_number() + right.as_number()};
+        return numbers;
+    case OpCode::SUBTRACT:
+        result = Value{left.as_number() - right.as_number()};
+        return numbers;
+    case OpCode::MULTIPLY:
+        result = Value{left.as_number() * right.as_number()};
+        return numbers;
+    case OpCode::DIVIDE:
+        result = Value{left.as_number() / right.as_number()};
+        return numbers && right.as_number() != 0.0;
+    case OpCode::POWER:
+        if (!numbers)
+            return false;
+        result = Value{evaluator::power(left.as_number(), right.as_number())};
+        return true;
+
+    case OpCode::EQUAL:
+    case OpCode::NOT_EQUAL: {
+        if (left.is_number() != right.is_number())
+            return false;
+        const bool equal = left.is_number()
+                               ? left.as_number() == right.as_number()
+                               : left.as_bool() == right.as_bool();
+        result = Value{equal == (op == OpCode::EQUAL)};
+        return true;
+    }
+    case OpCode::GREATER:
+        result = Value{left.as_number() > right.as_number()};
+        return numbers;
+    case OpCode::LESS:
+        result = Value{left.as_number() < right.as_number()};
+        return numbers;
+    case OpCode::GREATER_EQUAL:
+        result = Value{left.as_number() >= right.as_number()};
+        return numbers;
+    case OpCode::LESS_EQUAL:
+        result = Value{left.as_number() <= right.as_number()};
+        return numbers;
+
+    // The right operand is not checked when the left one decides the result
+    case OpCode::AND:
+        result = left.is_bool() && !left.as_bool() ? left : right;
+        return left.is_bool() && (!left.as_bool() || right.is_bool());
+    case OpCode::OR:
+        result = left.is_bool() && left.as_bool() ? left : right;
+        return left.is_bool() && (left.as_bool() || right.is_bool());
+
+    default:
+        return false;
+    }
+}
+
+/// @brief Returns whether the left operand of an && or || decides its result
+bool decides(OpCode op, Value left) {
+    return (op == OpCode::AND || op == OpCode::OR) && left.is_bool() &&
+           left.as_bool() == (op == OpCode::OR);
+}
+} // namespace
+
+std::uint32_t expression_evaluator::expression_set::ExpressionSet::intern(
+    const Node &node) {
+    const auto [found, added] =
+        index.try_emplace(node, static_cast<std::uint32_t>(nodes.size()));
+    if (added)
+        nodes.push_back(node);
+    return found->second;
+}
+
+size_t expression_evaluator::expression_set::ExpressionSet::add(
+    std::string_view expression) {
+    return add(compiler::optimize(compiler::compile(expression)));
+}
+
+size_t expression_evaluator::expression_set::ExpressionSet::add(
+    const compiler::CompiledExpression &program) {
+    // Straight-line code computes every operand, as nodes do
+    const std::vector<compiler::Instruction> code =
+        compiler::remove_jumps(program.get_code());
+    if (code.size() > UINT32_MAX - nodes.size())
+        throw std::runtime_error("Expression set too large");
+
+    std::vector<std::uint32_t> stack;
+    stack.reserve(program.get_max_stack_depth());
+    for (const compiler::Instruction &instruction : code) {
+        switch (instruction.op) {
+        case OpCode::PUSH_CONSTANT: {
+            // Constants are shared by bit pattern, so 0 and -0 stay apart
+            const Value constant = program.get_constants()[instruction.operand];
+            const auto [found, added] = constant_index.try_emplace(
+                std::bit_cast<std::uint64_t>(constant),
+                static_cast<std::uint32_t>(constants.size()));
+            if (added)
+                constants.push_back(constant);
+            stack.push_back(intern(Node{OpCode::PUSH_CONSTANT, found->second,
+                                        found->second}));
+            break;
+        }
+        case OpCode::LOAD_VARIABLE: {
+            const std::string &name =
+                program.get_variables()[instruction.operand];
+            const auto [found, added] = variable_index.try_emplace(
+                name, static_cast<std::uint32_t>(variables.size()));
+            if (added)
+                variables.push_back(name);
+            stack.push_back(intern(Node{OpCode::LOAD_VARIABLE, found->second,
+                                        found->second}));
+            break;
+        }
+        case OpCode::DUPLICATE:
+            stack.push_back(stack.back());
+            break;
+        case OpCode::NEGATE:
+        case OpCode::REQUIRE_NUMBER:
+        case OpCode::REQUIRE_BOOL:
+            stack.back() =
+                intern(Node{instruction.op, stack.back(), stack.back()});
+            break;
+        default: {
+            const std::uint32_t right = stack.back();
+            stack.pop_back();
+            stack.back() = intern(Node{instruction.op, stack.back(), right});
+            break;
+        }
+        }
+    }
+
+    roots.push_back(stack.back());
+    instruction_count += code.size();
+    return roots.size() - 1;
+}
+
+void expression_evaluator::expression_set::ExpressionSet::run(
+    std::span<const Value> bindings) const {
+    scratch.resize(nodes.size());
+    Value *const values = scratch.values.data();
+    const std::uint32_t *const failures = scratch.failures.data();
+
+    for (std::uint32_t id = 0; id < nodes.size(); id++) {
+        const Node &node = nodes[id];
+        switch (node.op) {
+        case OpCode::PUSH_CONSTANT:
+            values[id] = constants[node.left];
+            continue;
+        case OpCode::LOAD_VARIABLE:
+            values[id] = bindings[node.left];
+            continue;
+        default:
+            break;
+        }
+
+        const Value left = values[node.left];
+        const Value right = values[node.right];
+
+        // Failed operands are rare, so they are only looked for once some
+        // node has failed. A failed right operand of && or || does not
+        // count if the left one decides the result or is not a boolean
+        if (!scratch.failed_nodes.empty()) [[unlikely]] {
+            std::uint32_t failure = failures[node.left];
+            if (failure == 0 && failures[node.right] != 0 &&
+                ((node.op != OpCode::AND && node.op != OpCode::OR) ||
+                 (left.is_bool() && !decides(node.op, left))))
+                failure = failures[node.right];
+
+            if (failure != 0) {
+                scratch.fail(id, failure);
+                continue;
+            }
+        }
+
+        if (!apply(node.op, left, right, values[id])) [[unlikely]]
+            scratch.fail(id, compiler::try_apply(node.op, left, right)
+                                 .get_error());
+    }
+}
+
+void expression_evaluator::expression_set::ExpressionSet::try_evaluate(
+    std::span<const Value> bindings,
+    std::span<Result<Value>> results) const {
+    if (bindings.size() < variables.size()) {
+        for (size_t expression = 0; expression < roots.size(); expression++)
+            results[expression] =
+                Error::missing_bindings(variables.size(), bindings.size());
+        return;
+    }
+
+    run(bindings);
+    for (size_t expression = 0; expression < roots.size(); expression++) {
+        const std::uint32_t root = roots[expression];
+        if (const std::uint32_t failure = scratch.failures[root]; failure != 0)
+            results[expression] = scratch.errors[failure - 1];
+        else
+            results[expression] = scratch.values[root];
+    }
+
+    scratch.reset();
+}
+
+void expression_evaluator::expression_set::ExpressionSet::evaluate(
+    std::span<const Value> bindings, std::span<Value> results) const {
+    if (bindings.size() < variables.size())
+        Error::missing_bindings(variables.size(), bindings.size()).raise();
+
+    run(bindings);
+    for (size_t expression = 0; expression < roots.size(); expression++) {
+        const std::uint32_t root = roots[expression];
+        if (const std::uint32_t failure = scratch.failures[root];
+            failure != 0) {
+            const Error error = scratch.errors[failure - 1];
+            scratch.reset();
+            error.raise();
+        }
+
+        results[expression] = scratch.values[root];
+    }
+
+    scratch.reset();
+}
+
+std::optional<size_t>
+expression_evaluator::expression_set::ExpressionSet::find_variable(
+    std::string_view name) const {
+    const auto found = variable_index.find(std::string(name));
+    if (found == variable_index.end())
+        return std::nullopt;
+
+    return found->second;
+}
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <expression_evaluator/graph.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+expression_evaluator::graph::ExpressionGraph::Node::Node(std::string_view name)
+    : name(name),
+      result(Error::with_text(ErrorCode::UNBOUND_VARIABLE, this->name)) {}
+
+size_t
+expression_evaluator::graph::ExpressionGraph::intern(std::string_view name) {
+    if (const auto found = index.find(name); found != index.end())
+        return found->second;
+
+    const size_t id = nodes.size();
+    const Node &node = nodes.emplace_back(name);
+    index.emplace(node.name, id);
+    return id;
+}
+
+void expression_evaluator::graph::ExpressionGraph::detach(size_t id) {
+    for (const size_t dependency : nodes[id].dependencies)
+        std::erase(nodes[dependency].dependents, id);
+
+    nodes[id].dependencies.clear();
+}
+
+bool expression_evaluator::graph::ExpressionGraph::creates_cycle(
+    size_t id, const std::vector<size_t> &dependencies) {
+    // A cycle closes if one of the dependencies already depends on the node
+    const size_t search = ++searches;
+    std::vector<size_t> pending{id};
+    nodes[id].visit = search;
+    while (!pending.empty()) {
+        const size_t current = pending.back();
+        pending.pop_back();
+        if (std::ranges::find(dependencies, current) != dependencies.end())
+            return true;
+
+        for (const size_t dependent : nodes[current].dependents)
+            if (nodes[dependent].visit != search) {
+                nodes[dependent].visit = search;
+                pending.push_back(dependent);
+            }
+    }
+
+    return false;
+}
+
+void expression_evaluator::graph::ExpressionGraph::raise_levels(size_t id) {
+    std::vector<size_t> pending{id};
+    while (!pending.empty()) {
+        const size_t current = pending.back();
+        pending.pop_back();
+        for (const size_t dependent : nodes[current].dependents)
+            if (nodes[dependent].level <= nodes[current].level) {
+                nodes[dependent].level = nodes[current].level + 1;
+                pending.push_back(dependent);
+            }
+    }
+}
+
+void expression_evaluator::graph::ExpressionGraph::mark_dirty(size_t id) {
+    std::vector<size_t> pending{id};
+    while (!pending.empty()) {
+        const size_t current = pending.back();
+        pending.pop_back();
+
+        // The dependents of a dirty node were marked along with it
+        Node &node = nodes[current];
+        if (node.dirty)
+            continue;
+
+        node.dirty = true;
+        dirty.push_back(current);
+        pending.insert(pending.end(), node.dependents.begin(),
+                       node.dependents.end());
+    }
+}
+
+void expression_evaluator::graph::ExpressionGraph::evaluate(Node &node) {
+    bindings.clear();
+    for (const size_t dependency : node.dependencies) {
+        const Result<evaluator::Value> &input = nodes[dependency].result;
+        if (!input) {
+            node.result = input.get_error();
+            return;
+        }
+
+        bindings.push_back(input.value());
+    }
+
+    node.result = node.program->try_evaluate(bindings);
+}
+
+void expression_evaluator::graph::ExpressionGraph::set_input(
+    std::string_view name, evaluator::Value value) {
+    const size_t id = intern(name);
+    Node &node = nodes[id];
+    if (node.defined && !node.program && node.result &&
+        std::bit_cast<std::uint64_t>(node.result.value()) ==
+            std::bit_cast<std::uint64_t>(value))
+        return;
+
+    detach(id);
+    node.program.reset();
+    node.defined = true;
+    node.result = value;
+    // Dependents keep their levels, which stay greater
+    node.level = 0;
+    for (const size_t dependent : node.dependents)
+        mark_dirty(dependent);
+}
+
+expression_evaluator::Result<void>
+expression_evaluator::graph::ExpressionGraph::try_define(
+    std::string_view name, std::string_view expression) {
+    Result<compiler::CompiledExpression> compiled =
+        compiler::try_compile(expression);
+    if (!compiled)
+        return compiled.get_error();
+
+    const std::vector<std::string> &variables =
+        compiled.value().get_variables();
+    const auto existing = index.find(name);
+
+    // Look for cycles before adding nodes, so that the graph is unchanged if
+    // there is one. Names without a node cannot depend on anything yet
+    if (std::ranges::find(variables, name) != variables.end())
+        return Error::with_text(ErrorCode::CIRCULAR_REFERENCE, name);
+    if (existing != index.end()) {
+        std::vector<size_t> known;
+        for (const std::string &variable : variables)
+            if (const auto found = index.find(variable); found != index.end())
+                known.push_back(found->second);
+
+        if (creates_cycle(existing->second, known))
+            return Error::with_text(ErrorCode::CIRCULAR_REFERENCE,
+                                    nodes[existing->second].name);
+    }
+
+    const size_t id = intern(name);
+    std::vector<size_t> dependencies;
+    dependencies.reserve(variables.size());
+    for (const std::string &variable : variables)
+        dependencies.push_back(intern(variable));
+
+    detach(id);
+    Node &node = nodes[id];
+    node.program = compiler::optimize(compiled.value());
+    node.defined = true;
+    node.level = 1;
+    for (const size_t dependency : dependencies) {
+        nodes[dependency].dependents.push_back(id);
+        node.level = std::max(node.level, nodes[dependency].level + 1);
+    }
+    node.dependencies = std::move(dependencies);
+
+    raise_levels(id);
+    mark_dirty(id);
+    return {};
+}
+
+size_t expression_evaluator::graph::ExpressionGraph::recalculate() {
+    // Nodes only depend on nodes of lower levels
+    std::ranges::sort(dirty, {}, [this](size_t id) { return nodes[id].level; });
+
+    size_t count = 0;
+    for (const size_t id : dirty) {
+        Node &node = nodes[id];
+        node.dirty = false;
+        if (node.program) {
+            evaluate(node);
+            count++;
+        }
+    }
+
+    dirty.clear();
+    evaluations += count;
+    return count;
+}
+
+expression_evaluator::Result<expression_evaluator::evaluator::Value>
+expression_evaluator::graph::ExpressionGraph::try_get(std::string_view name) {
+    if (!dirty.empty())
+        recalculate();
+
+    const auto found = index.find(name);
+    if (found == index.end())
+        return Error::with_text(ErrorCode::UNBOUND_VARIABLE, name);
+
+    return nodes[found->second].result;
+}
+
+bool expression_evaluator::graph::ExpressionGraph::contains(
+    std::string_view name) const {
+    const auto found = index.find(name);
+    return found != index.end() && nodes[found->second].defined;
+}
+
+std::vector<std::string_view>
+expression_evaluator::graph::ExpressionGraph::get_dependencies(
+    std::string_view name) const {
+    std::vector<std::string_view> names;
+    if (const auto found = index.find(name); found != index.end())
+        for (const size_t dependency : nodes[found->second].dependencies)
+            names.push_back(nodes[dependency].name);
+
+    return names;
+}
@@ -0,0 +1,370 @@
+#include <cstddef>
+#include <expression_evaluator/compiler.hpp>
+#include <expression_evaluator/stats.hpp>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Dispatch through a table of label addresses (a GNU extension) unless a
+// portable build is requested, in which case a switch is used instead
+#if defined(__GNUC__) && !defined(EXPRESSION_EVALUATOR_PORTABLE_DISPATCH)
+#define EXPRESSION_EVALUATOR_THREADED_DISPATCH 1
+#endif
+
+namespace {
+using namespace expression_evaluator;
+using compiler::Instruction;
+using compiler::OpCode;
+using evaluator::Value;
+
+// Programs at most this deep run on a stack inside the interpreter's frame
+constexpr size_t INLINE_STACK_DEPTH = 64;
+
+// Values are copied into uninitialized stack slots without being destroyed
+static_assert(std::is_trivially_copyable_v<Value> &&
+              std::is_trivially_destructible_v<Value>);
+
+/// @brief Where a program stopped because an instruction's operands failed
+/// its checks. The operands are still on the stack
+struct Failure {
+    const Instruction *instruction = nullptr;
+    const Value *top = nullptr;
+};
+
+/// @brief Build the error of a failed instruction from its operands, with the
+/// same checks in the same order as apply_unary and apply_binary. Kept out of
+/// the interpreter loop, so that a failed check there is a single branch
+Error diagnose(const Failure &failure) {
+    const Value *top = failure.top;
+    const Value &last = top[-1];
+
+    switch (failure.instruction->op) {
+    case OpCode::NEGATE:
+    case OpCode::REQUIRE_NUMBER:
+        return Error::expected_number(last.as_bool());
+    case OpCode::REQUIRE_BOOL:
+    case OpCode::JUMP_IF_FALSE:
+    case OpCode::JUMP_IF_TRUE:
+        return Error::expected_boolean(last.as_number());
+    case OpCode::DIVIDE:
+        if (last.is_number() && last.as_number() == 0.0)
+            return Error(ErrorCode::DIVISION_BY_ZERO);
+        return Error::expected_number(last.is_number() ? top[-2].as_bool()
+                                                       : last.as_bool());
+    case OpCode::ADD:
+    case OpCode::SUBTRACT:
+    case OpCode::MULTIPLY:
+    case OpCode::POWER:
+    case OpCode::GREATER:
+    case OpCode::LESS:
+    case OpCode::GREATER_EQUAL:
+    case OpCode::LESS_EQUAL:
+        return Error::expected_number(top[-2].is_number() ? last.as_bool()
+                                                          : top[-2].as_bool());
+    case OpCode::EQUAL:
+    case OpCode::NOT_EQUAL:
+        return Error(ErrorCode::TYPE_MISMATCH);
+    case OpCode::AND:
+    case OpCode::OR:
+        return Error::expected_boolean(top[-2].is_bool() ? last.as_number()
+                                                         : top[-2].as_number());
+    default:
+        return Error(ErrorCode::UNKNOWN_OPERATOR);
+    }
+}
+
+#ifdef EXPRESSION_EVALUATOR_THREADED_DISPATCH
+// Label addresses and computed gotos are not ISO C++
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+/// @brief Run a program on a stack with room for its maximum depth. Each
+/// handler ends by jumping straight to the next instruction's handler, so
+/// every opcode gets its own indirect branch to predict
+/// @return The result, or an unspecified value after recording a failure
+Value run(const Instruction *instruction, const Instruction *end,
+          const Value *constants, const Value *bindings, Value *stack,
+          Failure &failure) {
+    // One past the value on top of the stack
+    Value *top = stack;
+
+#ifdef EXPRESSION_EVALUATOR_THREADED_DISPATCH
+    // Indexed by OpCode
+    static const void *const HANDLERS[] = {
+        &&PUSH_CONSTANT_HANDLER, &&LOAD_VARIABLE_HANDLER,
+        &&NEGATE_HANDLER,        &&REQUIRE_NUMBER_HANDLER,
+        &&REQUIRE_BOOL_HANDLER,  &&ADD_HANDLER,
+        &&SUBTRACT_HANDLER,      &&MULTIPLY_HANDLER,
+        &&DIVIDE_HANDLER,        &&POWER_HANDLER,
+        &&EQUAL_HANDLER,         &&NOT_EQUAL_HANDLER,
+        &&GREATER_HANDLER,       &&LESS_HANDLER,
+        &&GREATER_EQUAL_HANDLER, &&LESS_EQUAL_HANDLER,
+        &&AND_HANDLER,           &&OR_HANDLER,
+        &&JUMP_IF_FALSE_HANDLER, &&JUMP_IF_TRUE_HANDLER,
+        &&DUPLICATE_HANDLER,
+    };
+    static_assert(std::size(HANDLERS) ==
+                  static_cast<size_t>(OpCode::DUPLICATE) + 1);
+
+// The switch below is kept so that both builds share the handlers; threaded
+// dispatch jumps to the labels inside it directly
+#define HANDLER(op)                                                            \
+    case OpCode::op:                                                           \
+    op##_HANDLER:
+#define DISPATCH()                                                             \
+    do {                                                                       \
+        if (instruction == end)                                                \
+            return top[-1];                                                    \
+        goto *HANDLERS[static_cast<size_t>(instruction->op)];                  \
+    } while (false)
+#define NEXT()                                                                 \
+    do {                                                                       \
+        instruction++;                                                         \
+        DISPATCH();                                                            \
+    } while (false)
+
+    DISPATCH();
+#else
+#define HANDLER(op) case OpCode::op:
+#define NEXT() continue
+#endif
+
+// Stop at the current instruction, leaving its operands for diagnose()
+#define CHECK(condition)                                                       \
+    if (!(condition)) [[unlikely]]                                             \
+    goto failed
+// Load the two operands of a numeric operator
+#define NUMBERS(left, right)                                                   \
+    CHECK(top[-2].is_number() && top[-1].is_number());                         \
+    const double left = top[-2].as_number();                                   \
+    const double right = top[-1].as_number()
+// Compare the two operands, which have the same type
+#define EQUAL_VALUES()                                                         \
+    (top[-2].is_number() ? top[-2].as_number() == top[-1].as_number()          \
+                         : top[-2].as_bool() == top[-1].as_bool())
+
+    for (; instruction != end; instruction++) {
+        switch (instruction->op) {
+        HANDLER(PUSH_CONSTANT) {
+            std::construct_at(top++, constants[instruction->operand]);
+            NEXT();
+        }
+        HANDLER(LOAD_VARIABLE) {
+            std::construct_at(top++, bindings[instruction->operand]);
+            NEXT();
+        }
+        HANDLER(DUPLICATE) {
+            std::construct_at(top, top[-1]);
+            top++;
+            NEXT();
+        }
+
+        HANDLER(NEGATE) {
+            CHECK(top[-1].is_number());
+            top[-1] = Value{-top[-1].as_number()};
+            NEXT();
+        }
+        HANDLER(REQUIRE_NUMBER) {
+            CHECK(top[-1].is_number());
+            NEXT();
+        }
+        HANDLER(REQUIRE_BOOL) {
+            CHECK(top[-1].is_bool());
+            NEXT();
+        }
+
+        // Binary operators: the result replaces the left operand in place
+        HANDLER(ADD) {
+            NUMBERS(left, right);
+            top[-2] = Value{left + right};
+            top--;
+            NEXT();
+        }
+        HANDLER(SUBTRACT) {
+            NUMBERS(left, right);
+            top[-2] = Value{left - right};
+            top--;
+            NEXT();
+        }
+        HANDLER(MULTIPLY) {
+            NUMBERS(left, right);
+            top[-2] = Value{left * right};
+            top--;
+            NEXT();
+        }
+        HANDLER(DIVIDE) {
+            NUMBERS(left, right);
+            CHECK(right != 0.0);
+            top[-2] = Value{left / right};
+            top--;
+            NEXT();
+        }
+        HANDLER(POWER) {
+            NUMBERS(left, right);
+            top[-2] = Value{evaluator::power(left, right)};
+            top--;
+            NEXT();
+        }
+
+        HANDLER(EQUAL) {
+            CHECK(top[-2].is_number() == top[-1].is_number());
+            top[-2] = Value{EQUAL_VALUES()};
+            top--;
+            NEXT();
+        }
+        HANDLER(NOT_EQUAL) {
+            CHECK(top[-2].is_number() == top[-1].is_number());
+            top[-2] = Value{!EQUAL_VALUES()};
+            top--;
+            NEXT();
+        }
+        HANDLER(GREATER) {
+            NUMBERS(left, right);
+            top[-2] = Value{left > right};
+            top--;
+            NEXT();
+        }
+        HANDLER(LESS) {
+            NUMBERS(left, right);
+            top[-2] = Value{left < right};
+            top--;
+            NEXT();
+        }
+        HANDLER(GREATER_EQUAL) {
+            NUMBERS(left, right);
+            top[-2] = Value{left >= right};
+            top--;
+            NEXT();
+        }
+        HANDLER(LESS_EQUAL) {
+            NUMBERS(left, right);
+            top[-2] = Value{left <= right};
+            top--;
+            NEXT();
+        }
+
+        // The right operand is not checked when the left one decides the
+        // result
+        HANDLER(AND) {
+            CHECK(top[-2].is_bool() &&
+                  (!top[-2].as_bool() || top[-1].is_bool()));
+            top[-2] = Value{top[-2].as_bool() && top[-1].as_bool()};
+            top--;
+            NEXT();
+        }
+        HANDLER(OR) {
+            CHECK(top[-2].is_bool() &&
+                  (top[-2].as_bool() || top[-1].is_bool()));
+            top[-2] = Value{top[-2].as_bool() || top[-1].as_bool()};
+            top--;
+            NEXT();
+        }
+
+        // The jump lands one past the skipped instructions, as NEXT() also
+        // advances
+        HANDLER(JUMP_IF_FALSE) {
+            CHECK(top[-1].is_bool());
+            if (!top[-1].as_bool())
+                instruction += instruction->operand;
+            else
+                top--;
+            NEXT();
+        }
+        HANDLER(JUMP_IF_TRUE) {
+            CHECK(top[-1].is_bool());
+            if (top[-1].as_bool())
+                instruction += instruction->operand;
+            else
+                top--;
+            NEXT();
+        }
+        }
+
+        // An opcode without a handler
+        goto failed;
+    }
+
+    return top[-1];
+
+failed:
+    failure = Failure{instruction, top};
+    return Value{0.0};
+
+#undef HANDLER
+#undef NEXT
+#undef DISPATCH
+#undef CHECK
+#undef NUMBERS
+#undef EQUAL_VALUES
+}
+
+#ifdef EXPRESSION_EVALUATOR_THREADED_DISPATCH
+#pragma GCC diagnostic pop
+#endif
+} // namespace
+
+Result<evaluator::Value> expression_evaluator::compiler::try_execute(
+    std::span<const Instruction> code, std::span<const Value> constants,
+    size_t variable_count, size_t max_stack_depth,
+    std::span<const Value> bindings) {
+    stats::detail::StageTimer timer(stats::Stage::EXECUTE);
+    if (bindings.size() < variable_count) {
+        timer.fail();
+        return Error::missing_bindings(variable_count, bindings.size());
+    }
+
+    const Instruction *const begin = code.data();
+    const Instruction *const end = begin + code.size();
+
+    // The failure points into the stack, so both outlive diagnose()
+    Failure failure;
+    alignas(Value) std::byte storage[INLINE_STACK_DEPTH * sizeof(Value)];
+    Value result{0.0};
+    if (max_stack_depth <= INLINE_STACK_DEPTH) {
+        result = run(begin, end, constants.data(), bindings.data(),
+                     reinterpret_cast<Value *>(storage), failure);
+    } else {
+        // Reuse the calling thread's storage for deeper programs, so that
+        // steady-state evaluation does not allocate
+        thread_local std::vector<Value> stack;
+        if (stack.size() < max_stack_depth)
+            stack.resize(max_stack_depth, Value{0.0});
+
+        result = run(begin, end, constants.data(), bindings.data(),
+                     stack.data(), failure);
+    }
+
+    if (failure.instruction != nullptr) [[unlikely]] {
+        timer.fail();
+        return diagnose(failure);
+    }
+    return result;
+}
+
+Result<evaluator::Value>
+expression_evaluator::compiler::try_apply(OpCode op, const Value &left,
+                                          const Value &right) {
+    const bool unary = op == OpCode::NEGATE || op == OpCode::REQUIRE_NUMBER ||
+                       op == OpCode::REQUIRE_BOOL;
+
+    // Unary operators only load the left operand
+    Instruction code[] = {{OpCode::LOAD_VARIABLE, 0},
+                          {OpCode::LOAD_VARIABLE, 1},
+                          {op, 0}};
+    size_t size = std::size(code);
+    if (unary) {
+        code[1] = code[2];
+        size--;
+    }
+
+    const Value operands[] = {left, right};
+    Value stack[] = {Value{0.0}, Value{0.0}};
+    Failure failure;
+    const Value result =
+        run(code, code + size, nullptr, operands, stack, failure);
+    if (failure.instruction != nullptr)
+        return diagnose(failure);
+    return result;
+}
@@ -1,26 +1,263 @@
-#include <cctype>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstdint>
 #include <expression_evaluator/lexer.hpp>
-#include <stdexcept>
-#include <string>
+#include <expression_evaluator/stats.hpp>
+#include <optional>
+#include <string_view>
+#include <system_error>
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                              \
+    (defined(__GNUC__) || defined(__clang__))
+#define EXPRESSION_EVALUATOR_X86_SCANNERS
+#include <immintrin.h>
+#endif
 
 namespace {
-bool is_digit(char c) { return std::isdigit(static_cast<unsigned char>(c)); }
+using expression_evaluator::lexer::Scanner;
+
+// Character classes of the "C" locale, looked up in a table instead of going
+// through the locale-aware <cctype> functions
+constexpr std::uint8_t SPACE = 1;
+constexpr std::uint8_t DIGIT = 2;
+constexpr std::uint8_t IDENTIFIER_START = 4;
+
+constexpr std::array<std::uint8_t, 256> CHARACTER_CLASSES = [] {
+    std::array<std::uint8_t, 256> classes{};
+    for (const char c : {' ', '\t', '\n', '\v', '\f', '\r'})
+        classes[static_cast<unsigned char>(c)] = SPACE;
+    for (char c = '0'; c <= '9'; c++)
+        classes[static_cast<unsigned char>(c)] = DIGIT;
+    for (char c = 'a'; c <= 'z'; c++)
+        classes[static_cast<unsigned char>(c)] = IDENTIFIER_START;
+    for (char c = 'A'; c <= 'Z'; c++)
+        classes[static_cast<unsigned char>(c)] = IDENTIFIER_START;
+    classes[static_cast<unsigned char>('_')] = IDENTIFIER_START;
+    return classes;
+}();
+
+bool has_class(char c, std::uint8_t character_class) {
+    return (CHARACTER_CLASSES[static_cast<unsigned char>(c)] &
+            character_class) != 0;
+}
+
+bool is_space(char c) { return has_class(c, SPACE); }
+
+bool is_digit(char c) { return has_class(c, DIGIT); }
+
+bool is_identifier_start(char c) { return has_class(c, IDENTIFIER_START); }
+
+namespace scalar {
+/// @brief Skip characters in any of CLASSES, a combination of SPACE, DIGIT
+/// and IDENTIFIER_START
+template <std::uint8_t CLASSES>
+size_t skip(std::string_view text, size_t position) {
+    while (position < text.size() && has_class(text[position], CLASSES))
+        position++;
+
+    return position;
+}
+} // namespace scalar
+
+#ifdef EXPRESSION_EVALUATOR_X86_SCANNERS
+// The vector scanners classify a register of bytes at a time, and hand runs
+// reaching the last partial register to the scalar scanner, so that they
+// never read past the end of the text. Bytes are compared as unsigned, so
+// non-ASCII bytes belong to no class
+namespace sse2 {
+/// @brief Mark the bytes in [first, last]
+__attribute__((target("sse2"))) inline __m128i in_range(__m128i bytes,
+                                                        char first, char last) {
+    const __m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8(first));
+    return _mm_cmpeq_epi8(
+        _mm_min_epu8(offset, _mm_set1_epi8(static_cast<char>(last - first))),
+        offset);
+}
+
+template <std::uint8_t CLASSES>
+__attribute__((target("sse2"))) inline __m128i classify(__m128i bytes) {
+    __m128i members = _mm_setzero_si128();
+    if constexpr ((CLASSES & SPACE) != 0)
+        members = _mm_or_si128(
+            members, _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+                                  in_range(bytes, '\t', '\r')));
+    if constexpr ((CLASSES & DIGIT) != 0)
+        members = _mm_or_si128(members, in_range(bytes, '0', '9'));
+    // Setting bit 5 turns upper case letters into lower case ones
+    if constexpr ((CLASSES & IDENTIFIER_START) != 0)
+        members = _mm_or_si128(
+            members,
+            _mm_or_si128(
+                in_range(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z'),
+                _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_'))));
+    return members;
+}
+
+template <std::uint8_t CLASSES>
+__attribute__((target("sse2"))) size_t skip(std::string_view text,
+                                            size_t position) {
+    for (; position + 16 <= text.size(); position += 16) {
+        const __m128i bytes = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(text.data() + position));
+        const auto members = static_cast<unsigned>(
+            _mm_movemask_epi8(classify<CLASSES>(bytes)));
+        if (members != 0xffff)
+            return position + static_cast<size_t>(std::countr_one(members));
+    }
+
+    return scalar::skip<CLASSES>(text, position);
+}
+} // namespace sse2
+
+namespace avx2 {
+__attribute__((target("avx2"))) inline __m256i in_range(__m256i bytes,
+                                                        char first, char last) {
+    const __m256i offset = _mm256_sub_epi8(bytes, _mm256_set1_epi8(first));
+    return _mm256_cmpeq_epi8(
+        _mm256_min_epu8(offset,
+                        _mm256_set1_epi8(static_cast<char>(last - first))),
+        offset);
+}
+
+template <std::uint8_t CLASSES>
+__attribute__((target("avx2"))) inline __m256i classify(__m256i bytes) {
+    __m256i members = _mm256_setzero_si256();
+    if constexpr ((CLASSES & SPACE) != 0)
+        members = _mm256_or_si256(
+            members,
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+                            in_range(bytes, '\t', '\r')));
+    if constexpr ((CLASSES & DIGIT) != 0)
+        members = _mm256_or_si256(members, in_range(bytes, '0', '9'));
+    if constexpr ((CLASSES & IDENTIFIER_START) != 0)
+        members = _mm256_or_si256(
+            members,
+            _mm256_or_si256(
+                in_range(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)), 'a',
+                         'z'),
+                _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_'))));
+    return members;
+}
+
+template <std::uint8_t CLASSES>
+__attribute__((target("avx2"))) size_t skip(std::string_view text,
+                                            size_t position) {
+    for (; position + 32 <= text.size(); position += 32) {
+        const __m256i bytes = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(text.data() + position));
+        const auto members = static_cast<std::uint32_t>(
+            _mm256_movemask_epi8(classify<CLASSES>(bytes)));
+        if (members != UINT32_MAX)
+            return position + static_cast<size_t>(std::countr_one(members));
+    }
+
+    // Not sse2::skip, as returning through a function without AVX would
+    // skip the vzeroupper that avoids penalties in the caller's SSE code
+    return scalar::skip<CLASSES>(text, position);
+}
+} // namespace avx2
+#endif
+
+constexpr std::uint8_t IDENTIFIER_CHAR = IDENTIFIER_START | DIGIT;
+
+/// @brief Skip the rest of a run of characters in any of CLASSES with a
+/// scanner, out of line so that the lexer's loop stays small
+template <std::uint8_t CLASSES>
+[[gnu::noinline]] size_t skip_long(std::string_view text, size_t position,
+                                   Scanner scanner) {
+    switch (scanner) {
+#ifdef EXPRESSION_EVALUATOR_X86_SCANNERS
+    case Scanner::SSE2:
+        return sse2::skip<CLASSES>(text, position);
+    case Scanner::AVX2:
+        return avx2::skip<CLASSES>(text, position);
+#endif
+    default:
+        return scalar::skip<CLASSES>(text, position);
+    }
+}
+
+// Most runs end within a few bytes, which are checked before calling a
+// scanner; calling one for them costs more than it saves
+constexpr size_t SHORT_RUN = 4;
+
+/// @brief Skip characters in any of CLASSES, handing runs longer than
+/// SHORT_RUN to the scanner
+template <std::uint8_t CLASSES>
+inline size_t skip_run(std::string_view text, size_t position,
+                       Scanner scanner) {
+    for (const size_t short_end = position + SHORT_RUN; position < short_end;
+         position++)
+        if (position == text.size() || !has_class(text[position], CLASSES))
+            return position;
+
+    return skip_long<CLASSES>(text, position, scanner);
+}
+
+/// @brief Returns the fastest scanner the running CPU supports
+Scanner detect_scanner() noexcept {
+#ifdef EXPRESSION_EVALUATOR_X86_SCANNERS
+    // Needed when called during static initialization
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return Scanner::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return Scanner::SSE2;
+#endif
+    return Scanner::SCALAR;
+}
+
+// Lexers created during static initialization before this is initialized
+// use Scanner::SCALAR, the zero value
+const Scanner BEST_SCANNER = detect_scanner();
+
+/// @brief Parse a numeric literal without allocating. Integers that do not fit
+/// in 64 bits become FLOAT tokens
+/// @return The token, or an error if the literal cannot be parsed
+expression_evaluator::Result<std::optional<expression_evaluator::Token>>
+parse_number(std::string_view literal, bool has_dot,
+             std::uint32_t source_offset) {
+    using expression_evaluator::Error;
+    using expression_evaluator::ErrorCode;
+    using expression_evaluator::Token;
+
+    const char *first = literal.data();
+    const char *last = first + literal.size();
 
-bool is_alpha(char c) { return std::isalpha(static_cast<unsigned char>(c)); }
+    if (!has_dot) {
+        std::int64_t integer = 0;
+        const std::from_chars_result result =
+            std::from_chars(first, last, integer);
+        if (result.ec == std::errc{} && result.ptr == last)
+            return Token::from_integer(integer, source_offset);
+        else if (result.ec != std::errc::result_out_of_range)
+            return Error::with_text(ErrorCode::INVALID_NUMBER, literal,
+                                    source_offset);
+    }
+
+    double number = 0.0;
+    const std::from_chars_result result = std::from_chars(first, last, number);
+    if (result.ec != std::errc{} || result.ptr != last)
+        return Error::with_text(ErrorCode::INVALID_NUMBER, literal,
+                                source_offset);
+
+    return Token::from_float(number, source_offset);
+}
 } // namespace
 
-void expression_evaluator::lexer::tokenize(
-    std::string_view expression, structures::Queue<Token> &output_queue) {
-    size_t current_position = 0;
-    // For detecting unary minus
-    bool last_was_operator_or_lparen = true;
+expression_evaluator::Result<std::optional<expression_evaluator::Token>>
+expression_evaluator::lexer::Lexer::try_next() {
+    if (expression.size() > UINT32_MAX)
+        return Error(ErrorCode::EXPRESSION_TOO_LONG);
 
     while (current_position < expression.length()) {
         char current = expression[current_position];
 
         // Skip whitespace
-        if (std::isspace(static_cast<unsigned char>(current))) {
-            current_position++;
+        if (is_space(current)) {
+            current_position =
+                skip_run<SPACE>(expression, current_position + 1, scanner);
             continue;
         }
 
@@ -31,138 +268,151 @@ void expression_evaluator::lexer::tokenize(
             size_t start = current_position;
             bool has_dot = false;
 
+            // Runs of digits, separated by at most one dot
+            current_position =
+                skip_run<DIGIT>(expression, current_position, scanner);
             while (current_position < expression.length() &&
-                   (is_digit(expression[current_position]) ||
-                    expression[current_position] == '.')) {
-                if (expression[current_position] == '.') {
-                    if (has_dot)
-                        throw std::runtime_error(
-                            "Invalid number: multiple decimal points");
-
-                    has_dot = true;
-                }
-                current_position++;
-            }
+                   expression[current_position] == '.') {
+                if (has_dot)
+                    return Error(ErrorCode::MULTIPLE_DECIMAL_POINTS,
+                                 static_cast<std::uint32_t>(start));
 
-            std::string number_string(
-                expression.substr(start, current_position - start));
-            if (has_dot)
-                output_queue.enqueue(
-                    Token{TokenType::FLOAT, std::stod(number_string)});
-            else
-                output_queue.enqueue(
-                    Token{TokenType::INTEGER, std::stoi(number_string)});
+                has_dot = true;
+                current_position = skip_run<DIGIT>(
+                    expression, current_position + 1, scanner);
+            }
 
             last_was_operator_or_lparen = false;
-            continue;
+            return parse_number(
+                expression.substr(start, current_position - start), has_dot,
+                static_cast<std::uint32_t>(start));
         }
 
-        // Keywords (true, false)
-        if (is_alpha(current)) {
+        // Keywords (true, false) and variable names
+        if (is_identifier_start(current)) {
             size_t start = current_position;
-            while (current_position < expression.length() &&
-                   is_alpha(expression[current_position]))
-                current_position++;
-
-            std::string keyword(
-                expression.substr(start, current_position - start));
-            if (keyword == "true") {
-                output_queue.enqueue(Token{TokenType::TRUE, true});
-                last_was_operator_or_lparen = false;
-            } else if (keyword == "false") {
-                output_queue.enqueue(Token{TokenType::FALSE, false});
-                last_was_operator_or_lparen = false;
-            } else
-                throw std::runtime_error("Unknown keyword: " + keyword);
+            current_position = skip_run<IDENTIFIER_CHAR>(
+                expression, current_position + 1, scanner);
 
-            continue;
+            last_was_operator_or_lparen = false;
+
+            std::string_view word =
+                expression.substr(start, current_position - start);
+            if (word == "true")
+                return Token{TokenType::TRUE,
+                             static_cast<std::uint32_t>(start)};
+            else if (word == "false")
+                return Token{TokenType::FALSE,
+                             static_cast<std::uint32_t>(start)};
+            else
+                return Token::from_identifier(word);
         }
 
         // Two-character operators
         if (current_position + 1 < expression.length()) {
-            std::string two_char_operator =
-                std::string(expression.substr(current_position, 2));
+            const std::string_view two_char_operator =
+                expression.substr(current_position, 2);
 
-            if (two_char_operator == "==") {
-                output_queue.enqueue(Token{TokenType::EQUAL});
-                current_position += 2;
-                last_was_operator_or_lparen = true;
-                continue;
-            } else if (two_char_operator == "!=") {
-                output_queue.enqueue(Token{TokenType::NOT_EQUAL});
-                current_position += 2;
-                last_was_operator_or_lparen = true;
-                continue;
-            } else if (two_char_operator == ">=") {
-                output_queue.enqueue(Token{TokenType::GREATER_EQUAL});
-                current_position += 2;
-                last_was_operator_or_lparen = true;
-                continue;
-            } else if (two_char_operator == "<=") {
-                output_queue.enqueue(Token{TokenType::LESS_EQUAL});
-                current_position += 2;
-                last_was_operator_or_lparen = true;
-                continue;
-            } else if (two_char_operator == "&&") {
-                output_queue.enqueue(Token{TokenType::AND});
-                current_position += 2;
-                last_was_operator_or_lparen = true;
-                continue;
-            } else if (two_char_operator == "||") {
-                output_queue.enqueue(Token{TokenType::OR});
+            std::optional<TokenType> type;
+            if (two_char_operator == "==")
+                type = TokenType::EQUAL;
+            else if (two_char_operator == "!=")
+                type = TokenType::NOT_EQUAL;
+            else if (two_char_operator == ">=")
+                type = TokenType::GREATER_EQUAL;
+            else if (two_char_operator == "<=")
+                type = TokenType::LESS_EQUAL;
+            else if (two_char_operator == "&&")
+                type = TokenType::AND;
+            else if (two_char_operator == "||")
+                type = TokenType::OR;
+
+            if (type) {
+                const auto source_offset =
+                    static_cast<std::uint32_t>(current_position);
                 current_position += 2;
                 last_was_operator_or_lparen = true;
-                continue;
+                return Token{*type, source_offset};
             }
         }
 
         // Single-character operators and parentheses
+        TokenType type;
         switch (current) {
         case '+':
-            output_queue.enqueue(Token{TokenType::PLUS});
-            last_was_operator_or_lparen = true;
+            type = TokenType::PLUS;
             break;
         case '-':
-            if (last_was_operator_or_lparen)
-                output_queue.enqueue(Token{TokenType::UNARY_MINUS});
-            else
-                output_queue.enqueue(Token{TokenType::MINUS});
-
-            last_was_operator_or_lparen = true;
+            type = last_was_operator_or_lparen ? TokenType::UNARY_MINUS
+                                               : TokenType::MINUS;
             break;
         case '*':
-            output_queue.enqueue(Token{TokenType::MULTIPLY});
-            last_was_operator_or_lparen = true;
+            type = TokenType::MULTIPLY;
             break;
         case '/':
-            output_queue.enqueue(Token{TokenType::DIVIDE});
-            last_was_operator_or_lparen = true;
+            type = TokenType::DIVIDE;
             break;
         case '^':
-            output_queue.enqueue(Token{TokenType::POWER});
-            last_was_operator_or_lparen = true;
+            type = TokenType::POWER;
             break;
         case '>':
-            output_queue.enqueue(Token{TokenType::GREATER});
-            last_was_operator_or_lparen = true;
+            type = TokenType::GREATER;
             break;
         case '<':
-            output_queue.enqueue(Token{TokenType::LESS});
-            last_was_operator_or_lparen = true;
+            type = TokenType::LESS;
             break;
         case '(':
-            output_queue.enqueue(Token{TokenType::LEFT_PAREN});
-            last_was_operator_or_lparen = true;
+            type = TokenType::LEFT_PAREN;
             break;
         case ')':
-            output_queue.enqueue(Token{TokenType::RIGHT_PAREN});
-            last_was_operator_or_lparen = false;
+            type = TokenType::RIGHT_PAREN;
             break;
         default:
-            throw std::runtime_error(std::string("Unexpected character: '") +
-                                     current + "'");
+            return Error::with_text(
+                ErrorCode::UNEXPECTED_CHARACTER,
+                expression.substr(current_position, 1),
+                static_cast<std::uint32_t>(current_position));
         }
 
+        const auto source_offset = static_cast<std::uint32_t>(current_position);
         current_position++;
+        last_was_operator_or_lparen = type != TokenType::RIGHT_PAREN;
+        return Token{type, source_offset};
     }
+
+    return std::nullopt;
+}
+
+expression_evaluator::lexer::Scanner
+expression_evaluator::lexer::best_scanner() noexcept {
+    return BEST_SCANNER;
+}
+
+bool expression_evaluator::lexer::is_supported(Scanner scanner) noexcept {
+    // Each scanner needs the instruction sets of those before it
+    return scanner <= BEST_SCANNER;
+}
+
+expression_evaluator::Result<void>
+expression_evaluator::lexer::try_tokenize(std::string_view expression,
+                                          TokenQueue &output_queue) {
+    stats::detail::StageTimer timer(stats::Stage::TOKENIZE);
+    Lexer lexer(expression);
+    while (true) {
+        Result<std::optional<Token>> token = lexer.try_next();
+        if (!token) {
+            timer.fail();
+            return token.get_error();
+        }
+        if (!token.value())
+            return {};
+
+        output_queue.enqueue(std::move(*token.value()));
+        timer.add_tokens(1);
+    }
+}
+
+void expression_evaluator::lexer::tokenize(std::string_view expression,
+                                           TokenQueue &output_queue) {
+    try_tokenize(expression, output_queue).value();
 }
@@ -1,17 +1,53 @@
-#include <expression_evaluator/evaluator.hpp>
-#include <expression_evaluator/lexer.hpp>
-#include <expression_evaluator/parser.hpp>
-#include <expression_evaluator/structures/queue.hpp>
-#include <expression_evaluator/token.hpp>
+#include <charconv>
+#include <cstdio>
+#include <exception>
+#include <expression_evaluator/batch.hpp>
+#include <expression_evaluator/cache.hpp>
+#include <expression_evaluator/compiler.hpp>
+#include <expression_evaluator/mapped_file.hpp>
+#include <expression_evaluator/serialization.hpp>
+#include <expression_evaluator/stats.hpp>
 #include <iostream>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
 
-int main() {
-    using expression_evaluator::Token;
-    using expression_evaluator::evaluator::Value;
-    using expression_evaluator::structures::Queue;
-    namespace evaluator = expression_evaluator::evaluator;
-    namespace lexer = expression_evaluator::lexer;
-    namespace parser = expression_evaluator::parser;
+namespace {
+using expression_evaluator::MappedFile;
+namespace batch = expression_evaluator::batch;
+namespace compiler = expression_evaluator::compiler;
+namespace serialization = expression_evaluator::serialization;
+namespace stats = expression_evaluator::stats;
+
+void print_usage(const char *program) {
+    std::cerr << "Usage: " << program
+              << " [--batch [FILE] [--threads N]] [--stats]\n"
+              << "       " << program << " compile RULES OUTPUT [--stats]\n"
+              << "  With no arguments, evaluate expressions interactively.\n"
+              << "  --batch FILE  Evaluate each line of FILE (or of standard "
+                 "input if FILE\n"
+              << "                is omitted or '-') and print one result or "
+                 "error per line.\n"
+              << "  --threads N   Evaluate the batch on N threads (default: "
+                 "one per\n"
+              << "                hardware thread).\n"
+              << "  compile       Compile and optimize each non-empty line of "
+                 "RULES into\n"
+              << "                one program of a binary image written to "
+                 "OUTPUT ('-' for\n"
+              << "                standard input or output).\n"
+              << "  --stats       Print the time spent and counters of each "
+                 "stage to standard\n"
+              << "                error on exit.\n";
+}
+
+int run_interactive() {
+    // Repeated expressions are evaluated without lexing and parsing again
+    expression_evaluator::cache::ExpressionCache cache;
 
     std::cout << "Expression Evaluator" << std::endl;
     std::cout
@@ -33,19 +69,155 @@ int main() {
             break;
 
         try {
-            Queue<Token> output_queue;
-            lexer::tokenize(expression, output_queue);
+            // The same results and errors as --batch
+            const auto result =
+                batch::try_evaluate_program(cache.get(expression), expression);
+            if (result)
+                std::cout << result.value().to_string() << std::endl;
+            else
+                std::cerr << result.get_error().message() << std::endl;
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
 
-            Queue<Token> postfix_queue;
-            parser::to_postfix(output_queue, postfix_queue);
+    return 0;
+}
 
-            Value result = evaluator::evaluate_expression(postfix_queue);
+int run_batch(const std::string &path, unsigned thread_count) {
+    try {
+        const MappedFile input(path);
+        batch::BufferedWriter output(stdout);
+        (void)batch::evaluate_lines(input.get_contents(), output, thread_count);
+        output.flush();
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
 
-            std::cout << result.to_string() << std::endl;
-        } catch (const std::exception &e) {
-            std::cerr << e.what() << std::endl;
+    return 0;
+}
+
+int run_compile(const std::string &rules_path, const std::string &output_path) {
+    try {
+        const MappedFile rules(rules_path);
+        const std::string_view input = rules.get_contents();
+
+        std::vector<compiler::CompiledExpression> programs;
+        size_t line_number = 0;
+        size_t start = 0;
+        while (start < input.size()) {
+            size_t end = input.find('\n', start);
+            if (end == std::string_view::npos)
+                end = input.size();
+
+            std::string_view line = input.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+            line_number++;
+            start = end + 1;
+            if (line.empty())
+                continue;
+
+            auto program = compiler::try_compile(line);
+            if (!program) {
+                std::cerr << rules_path << ":" << line_number << ": "
+                          << program.get_error().message() << std::endl;
+                return 1;
+            }
+            programs.push_back(compiler::optimize(program.value()));
         }
+
+        const bool is_stdout = output_path == "-";
+        std::FILE *stream =
+            is_stdout ? stdout : std::fopen(output_path.c_str(), "wb");
+        if (stream == nullptr)
+            throw std::runtime_error("Cannot open '" + output_path + "'");
+
+        try {
+            batch::BufferedWriter output(stream);
+            output.write(serialization::serialize(programs));
+            output.flush();
+        } catch (...) {
+            if (!is_stdout)
+                std::fclose(stream);
+            throw;
+        }
+
+        if (!is_stdout && std::fclose(stream) != 0)
+            throw std::runtime_error("Cannot write '" + output_path + "'");
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+/// @brief Run the mode selected by the arguments, other than --stats
+int run(const char *program, std::span<const std::string_view> arguments) {
+    if (arguments.empty())
+        return run_interactive();
+
+    if (arguments[0] == "compile") {
+        if (arguments.size() != 3) {
+            print_usage(program);
+            return 1;
+        }
+
+        return run_compile(std::string(arguments[1]),
+                           std::string(arguments[2]));
+    }
+
+    std::optional<std::string> path;
+    unsigned thread_count = 0;
+    bool batch_mode = false;
+    for (size_t i = 0; i < arguments.size(); i++) {
+        const std::string_view argument = arguments[i];
+        if (argument == "--batch" && !batch_mode)
+            batch_mode = true;
+        else if (argument == "--threads" && i + 1 < arguments.size()) {
+            const std::string_view count = arguments[++i];
+            const std::from_chars_result result = std::from_chars(
+                count.data(), count.data() + count.size(), thread_count);
+            if (result.ec != std::errc{} ||
+                result.ptr != count.data() + count.size()) {
+                print_usage(program);
+                return 1;
+            }
+        } else if (batch_mode && !path && !argument.starts_with("--"))
+            path = std::string(argument);
+        else {
+            print_usage(program);
+            return 1;
+        }
+    }
+
+    if (!batch_mode) {
+        print_usage(program);
+        return 1;
+    }
+
+    return run_batch(path.value_or("-"), thread_count);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::string_view> arguments(argv + 1, argv + argc);
+    const bool print_stats =
+        std::erase(arguments, std::string_view("--stats")) != 0;
+    if (print_stats) {
+        if (!stats::COMPILED_IN)
+            std::cerr << "Statistics were not compiled in; configure with "
+                         "-Dstats=true"
+                      << std::endl;
+        stats::set_enabled(true);
+    }
+
+    const int status = run(argv[0], arguments);
+
+    // Worker threads have exited, and their counters are included
+    if (print_stats && stats::COMPILED_IN)
+        std::cerr << stats::snapshot().to_string();
+    return status;
+}
@@ -0,0 +1,102 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <expression_evaluator/mapped_file.hpp>
+#include <stdexcept>
+#include <string>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define EXPRESSION_EVALUATOR_MMAP 1
+#endif
+
+namespace {
+[[noreturn]] void throw_io_error(const std::string &what,
+                                 const std::string &path) {
+    throw std::runtime_error(what + " '" + path + "': " + std::strerror(errno));
+}
+
+#ifdef EXPRESSION_EVALUATOR_MMAP
+/// @brief Read everything left in a file descriptor
+void read_all(int descriptor, const std::string &path, std::string &contents) {
+    char chunk[1 << 16];
+    while (true) {
+        const ssize_t count = ::read(descriptor, chunk, sizeof(chunk));
+        if (count == 0)
+            return;
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            throw_io_error("Cannot read", path);
+        }
+
+        contents.append(chunk, static_cast<size_t>(count));
+    }
+}
+#endif
+} // namespace
+
+#ifdef EXPRESSION_EVALUATOR_MMAP
+expression_evaluator::MappedFile::MappedFile(const std::string &path) {
+    const bool is_stdin = path == "-";
+    const int descriptor =
+        is_stdin ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        throw_io_error("Cannot open", path);
+
+    try {
+        struct stat status {};
+        if (::fstat(descriptor, &status) != 0)
+            throw_io_error("Cannot stat", path);
+
+        // Pipes and terminals cannot be mapped, and empty files need not be
+        if (S_ISREG(status.st_mode) && status.st_size > 0) {
+            length = static_cast<size_t>(status.st_size);
+            void *address =
+                ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (address == MAP_FAILED)
+                throw_io_error("Cannot map", path);
+
+            (void)::madvise(address, length, MADV_SEQUENTIAL);
+            mapping = static_cast<const char *>(address);
+        } else
+            read_all(descriptor, path, contents);
+    } catch (...) {
+        if (!is_stdin)
+            ::close(descriptor);
+        throw;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    if (!is_stdin)
+        ::close(descriptor);
+}
+
+expression_evaluator::MappedFile::~MappedFile() {
+    if (mapping != nullptr)
+        ::munmap(const_cast<char *>(mapping), length);
+}
+#else
+expression_evaluator::MappedFile::MappedFile(const std::string &path) {
+    const bool is_stdin = path == "-";
+    std::FILE *file = is_stdin ? stdin : std::fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        throw_io_error("Cannot open", path);
+
+    char chunk[1 << 16];
+    size_t count;
+    while ((count = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+        contents.append(chunk, count);
+
+    const bool failed = std::ferror(file) != 0;
+    if (!is_stdin)
+        std::fclose(file);
+    if (failed)
+        throw_io_error("Cannot read", path);
+}
+
+expression_evaluator::MappedFile::~MappedFile() = default;
+#endif
@@ -0,0 +1,343 @@
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <expression_evaluator/compiler.hpp>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+using namespace expression_evaluator;
+using compiler::Instruction;
+using compiler::OpCode;
+using compiler::OptimizationStats;
+using evaluator::Value;
+
+enum class StaticType : std::uint8_t {
+    NUMBER,
+    BOOLEAN,
+    // Variables may be bound to either type
+    UNKNOWN,
+};
+
+/// @brief A value on the optimizer's symbolic stack. The instructions that
+/// compute it are code[start, start of the next operand on the stack)
+struct Operand {
+    size_t start;
+    StaticType type;
+    // Set when the operand is a single PUSH_CONSTANT
+    std::optional<Value> constant;
+    // Set when the last instruction is a NEGATE, to the type of its operand
+    std::optional<StaticType> negated_type;
+};
+
+bool is_constant(const Operand &operand, double number) {
+    return operand.constant && operand.constant->is_number() &&
+           operand.constant->as_number() == number &&
+           std::signbit(operand.constant->as_number()) == std::signbit(number);
+}
+
+bool is_constant(const Operand &operand, bool boolean) {
+    return operand.constant && operand.constant->is_bool() &&
+           operand.constant->as_bool() == boolean;
+}
+
+bool is_arithmetic(OpCode op) {
+    return op == OpCode::ADD || op == OpCode::SUBTRACT ||
+           op == OpCode::MULTIPLY || op == OpCode::DIVIDE ||
+           op == OpCode::POWER;
+}
+
+/// @brief Rebuilds a program instruction by instruction, folding and
+/// simplifying operators as their operands become known
+class Optimizer {
+  private:
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    // Index of each constant in the pool, so that equal constants share an
+    // entry. Numbers are keyed by bit pattern to keep 0 and -0 apart
+    std::unordered_map<std::uint64_t, std::optional<std::uint32_t>>
+        number_constants;
+    std::optional<std::uint32_t> bool_constants[2];
+    std::vector<Operand> stack;
+    OptimizationStats &stats;
+
+    std::uint32_t add_constant(const Value &value) {
+        std::optional<std::uint32_t> &index =
+            value.is_bool()
+                ? bool_constants[value.as_bool() ? 1 : 0]
+                : number_constants[std::bit_cast<std::uint64_t>(
+                      value.as_number())];
+        if (!index) {
+            index = static_cast<std::uint32_t>(constants.size());
+            constants.push_back(value);
+        }
+
+        return *index;
+    }
+
+    /// @brief Ensure the operand on top of the stack has the given type,
+    /// appending a type check if that is not known at compile time
+    void require(StaticType type) {
+        Operand &operand = stack.back();
+        if (operand.type == type)
+            return;
+
+        code.push_back(Instruction{type == StaticType::NUMBER
+                                       ? OpCode::REQUIRE_NUMBER
+                                       : OpCode::REQUIRE_BOOL,
+                                   0});
+        operand.type = type;
+        operand.constant.reset();
+        operand.negated_type.reset();
+    }
+
+    /// @brief Remove the left operand (a single constant) of a binary
+    /// operator, so that the operator's result is its right operand
+    void drop_left_constant(Operand &left, const Operand &right) {
+        code.erase(code.begin() + static_cast<std::ptrdiff_t>(left.start));
+        const size_t start = left.start;
+        left = right;
+        left.start = start;
+    }
+
+    /// @brief Apply identities to a binary operator whose operands are on top
+    /// of the stack
+    /// @return Whether the operator was simplified away
+    bool simplify(OpCode op, Operand &left, const Operand &right) {
+        // x * 1, x / 1, x ^ 1 and x - 0 all equal x for every number
+        // (including -0, infinities and NaN); 1 * x equals x. x + 0 is not
+        // simplified because -0 + 0 is +0
+        if (((op == OpCode::MULTIPLY || op == OpCode::DIVIDE ||
+              op == OpCode::POWER) &&
+             is_constant(right, 1.0)) ||
+            (op == OpCode::SUBTRACT && is_constant(right, 0.0))) {
+            code.resize(right.start);
+            require(StaticType::NUMBER);
+            return true;
+        }
+        if (op == OpCode::MULTIPLY && is_constant(left, 1.0)) {
+            drop_left_constant(left, right);
+            require(StaticType::NUMBER);
+            return true;
+        }
+
+        // true && p and false || p equal p, once p is known to be a boolean
+        const bool identity = op == OpCode::AND;
+        if ((op == OpCode::AND || op == OpCode::OR) &&
+            is_constant(left, identity)) {
+            drop_left_constant(left, right);
+            require(StaticType::BOOLEAN);
+            return true;
+        }
+        if ((op == OpCode::AND || op == OpCode::OR) &&
+            is_constant(right, identity)) {
+            code.resize(right.start);
+            require(StaticType::BOOLEAN);
+            return true;
+        }
+
+        // false && p and true || p never evaluate p, so p is dropped along
+        // with any error it would raise
+        if ((op == OpCode::AND || op == OpCode::OR) &&
+            is_constant(left, !identity)) {
+            code.resize(right.start);
+            return true;
+        }
+
+        return false;
+    }
+
+  public:
+    explicit Optimizer(OptimizationStats &stats) : stats(stats) {}
+
+    void push_constant(const Value &value) {
+        stack.push_back(Operand{
+            code.size(),
+            value.is_bool() ? StaticType::BOOLEAN : StaticType::NUMBER, value,
+            std::nullopt});
+        code.push_back(Instruction{OpCode::PUSH_CONSTANT, add_constant(value)});
+    }
+
+    void load_variable(std::uint32_t slot) {
+        stack.push_back(Operand{code.size(), StaticType::UNKNOWN,
+                                std::nullopt, std::nullopt});
+        code.push_back(Instruction{OpCode::LOAD_VARIABLE, slot});
+    }
+
+    void duplicate() {
+        const Operand top = stack.back();
+        if (top.constant) {
+            push_constant(*top.constant);
+            return;
+        }
+
+        stack.push_back(
+            Operand{code.size(), top.type, std::nullopt, std::nullopt});
+        code.push_back(Instruction{OpCode::DUPLICATE, 0});
+    }
+
+    void apply_unary(OpCode op) {
+        Operand &operand = stack.back();
+
+        if (operand.constant) {
+            try {
+                const Value result =
+                    compiler::apply_unary(op, *operand.constant);
+                code.resize(operand.start);
+                stack.pop_back();
+                push_constant(result);
+                stats.folded_operations++;
+                return;
+            } catch (const std::runtime_error &) {
+                // Leave the error to be raised on evaluation
+            }
+        }
+
+        if (op == OpCode::REQUIRE_NUMBER || op == OpCode::REQUIRE_BOOL) {
+            require(op == OpCode::REQUIRE_NUMBER ? StaticType::NUMBER
+                                                 : StaticType::BOOLEAN);
+            return;
+        }
+
+        // --x equals x once x is known to be a number
+        if (operand.negated_type) {
+            code.pop_back();
+            operand.type = *operand.negated_type;
+            operand.negated_type.reset();
+            require(StaticType::NUMBER);
+            stats.simplified_operations += 2;
+            return;
+        }
+
+        code.push_back(Instruction{op, 0});
+        operand.negated_type = operand.type;
+        operand.type = StaticType::NUMBER;
+        operand.constant.reset();
+    }
+
+    void apply_binary(OpCode op) {
+        const Operand right = stack.back();
+        stack.pop_back();
+        Operand &left = stack.back();
+
+        if (left.constant && right.constant) {
+            try {
+                const Value result = compiler::apply_binary(
+                    op, *left.constant, *right.constant);
+                code.resize(left.start);
+                stack.pop_back();
+                push_constant(result);
+                stats.folded_operations++;
+                return;
+            } catch (const std::runtime_error &) {
+                // Leave the error to be raised on evaluation
+            }
+        }
+
+        if (simplify(op, left, right)) {
+            stats.simplified_operations++;
+            return;
+        }
+
+        code.push_back(Instruction{op, 0});
+
+        left.type =
+            is_arithmetic(op) ? StaticType::NUMBER : StaticType::BOOLEAN;
+        left.constant.reset();
+        left.negated_type.reset();
+    }
+
+    /// @brief Return the optimized instructions, constant pool and maximum
+    /// stack depth
+    void finish(std::vector<Instruction> &out_code,
+                std::vector<Value> &out_constants, size_t &max_stack_depth) {
+        // Folding can leave constants that are no longer referenced, so the
+        // pool is rebuilt from the remaining instructions
+        std::vector<std::uint32_t> remap(constants.size(), UINT32_MAX);
+        size_t depth = 0;
+        max_stack_depth = 0;
+
+        for (Instruction &instruction : code) {
+            switch (instruction.op) {
+            case OpCode::PUSH_CONSTANT: {
+                std::uint32_t &index = remap[instruction.operand];
+                if (index == UINT32_MAX) {
+                    index = static_cast<std::uint32_t>(out_constants.size());
+                    out_constants.push_back(constants[instruction.operand]);
+                }
+                instruction.operand = index;
+                depth++;
+                break;
+            }
+            case OpCode::LOAD_VARIABLE:
+            case OpCode::DUPLICATE:
+                depth++;
+                break;
+            case OpCode::NEGATE:
+            case OpCode::REQUIRE_NUMBER:
+            case OpCode::REQUIRE_BOOL:
+                break;
+            default:
+                depth--;
+                break;
+            }
+
+            if (depth > max_stack_depth)
+                max_stack_depth = depth;
+        }
+
+        out_code = std::move(code);
+    }
+};
+} // namespace
+
+compiler::CompiledExpression
+expression_evaluator::compiler::optimize(const CompiledExpression &program,
+                                         OptimizationStats &stats) {
+    stats = OptimizationStats{};
+    stats.instructions_before = program.code.size();
+
+    // Operands are easier to track without jumps; they are inserted again
+    // once the program is rebuilt
+    Optimizer optimizer(stats);
+    for (const Instruction &instruction : remove_jumps(program.code)) {
+        switch (instruction.op) {
+        case OpCode::PUSH_CONSTANT:
+            optimizer.push_constant(program.constants[instruction.operand]);
+            break;
+        case OpCode::LOAD_VARIABLE:
+            optimizer.load_variable(instruction.operand);
+            break;
+        case OpCode::DUPLICATE:
+            optimizer.duplicate();
+            break;
+        case OpCode::NEGATE:
+        case OpCode::REQUIRE_NUMBER:
+        case OpCode::REQUIRE_BOOL:
+            optimizer.apply_unary(instruction.op);
+            break;
+        default:
+            optimizer.apply_binary(instruction.op);
+            break;
+        }
+    }
+
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    size_t max_stack_depth = 0;
+    optimizer.finish(code, constants, max_stack_depth);
+    code = insert_jumps(code);
+    stats.instructions_after = code.size();
+
+    return CompiledExpression{std::move(code), std::move(constants),
+                              program.variables, max_stack_depth};
+}
+
+compiler::CompiledExpression
+expression_evaluator::compiler::optimize(const CompiledExpression &program) {
+    OptimizationStats stats;
+    return optimize(program, stats);
+}
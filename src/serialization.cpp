@@ -0,0 +1,338 @@
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expression_evaluator/serialization.hpp>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+using namespace expression_evaluator;
+using serialization::ImageHeader;
+using serialization::ProgramRecord;
+using serialization::VariableRecord;
+
+// Views alias the instructions and constants of an image in place
+static_assert(sizeof(compiler::Instruction) == 8 &&
+              offsetof(compiler::Instruction, operand) == 4 &&
+              std::is_trivially_copyable_v<compiler::Instruction>);
+static_assert(sizeof(ImageHeader) == 32 && sizeof(ProgramRecord) == 40 &&
+              sizeof(VariableRecord) == 16);
+
+constexpr std::uint64_t FNV_OFFSET_BASIS = 0xcbf2'9ce4'8422'2325;
+constexpr std::uint64_t FNV_PRIME = 0x100'0000'01b3;
+
+std::uint64_t fnv1a(std::string_view bytes,
+                    std::uint64_t hash = FNV_OFFSET_BASIS) {
+    for (const char byte : bytes)
+        hash = (hash ^ static_cast<unsigned char>(byte)) * FNV_PRIME;
+    return hash;
+}
+
+/// @brief The checksum of an image: FNV-1a of all of it, with the checksum
+/// field taken as zero
+std::uint64_t checksum(std::string_view image) {
+    constexpr size_t field = offsetof(ImageHeader, checksum);
+    std::uint64_t hash = fnv1a(image.substr(0, field));
+    hash = fnv1a(std::string_view("\0\0\0\0\0\0\0\0", 8), hash);
+    return fnv1a(image.substr(field + sizeof(std::uint64_t)), hash);
+}
+
+/// @brief Write an unsigned integer in little-endian order
+template <typename T> void store(std::string &image, size_t offset, T value) {
+    for (size_t byte = 0; byte < sizeof(T); byte++)
+        image[offset + byte] =
+            static_cast<char>(static_cast<unsigned char>(value >> (8 * byte)));
+}
+
+template <typename T> void append(std::string &image, T value) {
+    const size_t offset = image.size();
+    image.resize(offset + sizeof(T));
+    store(image, offset, value);
+}
+
+void align(std::string &image) { image.resize((image.size() + 7) / 8 * 8); }
+
+std::uint32_t to_count(size_t count) {
+    if (count > UINT32_MAX)
+        throw std::runtime_error("Program too large to serialize");
+    return static_cast<std::uint32_t>(count);
+}
+
+void store_record(std::string &image, size_t offset,
+                  const ProgramRecord &record) {
+    store(image, offset + offsetof(ProgramRecord, code_offset),
+          record.code_offset);
+    store(image, offset + offsetof(ProgramRecord, constants_offset),
+          record.constants_offset);
+    store(image, offset + offsetof(ProgramRecord, variables_offset),
+          record.variables_offset);
+    store(image, offset + offsetof(ProgramRecord, code_size),
+          record.code_size);
+    store(image, offset + offsetof(ProgramRecord, constant_count),
+          record.constant_count);
+    store(image, offset + offsetof(ProgramRecord, variable_count),
+          record.variable_count);
+    store(image, offset + offsetof(ProgramRecord, max_stack_depth),
+          record.max_stack_depth);
+}
+
+[[noreturn]] void throw_invalid_image(const std::string &reason) {
+    throw std::runtime_error("Invalid program image: " + reason);
+}
+
+/// @brief Returns whether count items of a size, from an offset aligned to 8
+/// bytes, lie within an image
+bool fits(std::uint64_t offset, std::uint64_t count, std::uint64_t size,
+          std::uint64_t image_size) {
+    // count is 32 bits and size small, so the product cannot overflow
+    return offset % 8 == 0 && offset <= image_size &&
+           count * size <= image_size - offset;
+}
+
+/// @brief Check that a program only reads within the image, its constants,
+/// its variables and a stack of its max_stack_depth, so that a damaged
+/// record fails here instead of when it is evaluated
+/// @param landings Scratch space for the jumps being checked
+/// @throws std::runtime_error if it does not
+void check_program(std::string_view image, std::uint32_t version,
+                   const ProgramRecord &record,
+                   std::vector<std::pair<size_t, size_t>> &landings) {
+    using compiler::OpCode;
+
+    if (!fits(record.code_offset, record.code_size,
+              sizeof(compiler::Instruction), image.size()) ||
+        !fits(record.constants_offset, record.constant_count,
+              sizeof(evaluator::Value), image.size()) ||
+        !fits(record.variables_offset, record.variable_count,
+              sizeof(VariableRecord), image.size()))
+        throw_invalid_image("program out of bounds");
+
+    for (size_t slot = 0; slot < record.variable_count; slot++) {
+        VariableRecord variable;
+        std::memcpy(&variable,
+                    image.data() + record.variables_offset +
+                        slot * sizeof(variable),
+                    sizeof(variable));
+        if (variable.name_offset > image.size() ||
+            variable.name_length > image.size() - variable.name_offset)
+            throw_invalid_image("variable name out of bounds");
+    }
+
+    // Version 1 predates DUPLICATE
+    const OpCode last = version >= 2 ? OpCode::DUPLICATE : OpCode::JUMP_IF_TRUE;
+
+    // Walk the code as if no jump were taken, checking that each taken jump
+    // lands where the stack is as deep as it leaves it. Jumps only skip
+    // forward, over whole operands, so they nest and their landings are kept
+    // as a stack of (index, depth)
+    landings.clear();
+    size_t depth = 0;
+    for (size_t index = 0; index <= record.code_size; index++) {
+        while (!landings.empty() && landings.back().first == index) {
+            if (landings.back().second != depth)
+                throw_invalid_image("jump to a different stack depth");
+            landings.pop_back();
+        }
+        if (index == record.code_size)
+            break;
+
+        const char *bytes = image.data() + record.code_offset +
+                            index * sizeof(compiler::Instruction);
+        const auto op = static_cast<OpCode>(static_cast<unsigned char>(
+            bytes[offsetof(compiler::Instruction, op)]));
+        std::uint32_t operand;
+        std::memcpy(&operand, bytes + offsetof(compiler::Instruction, operand),
+                    sizeof(operand));
+        if (op > last)
+            throw_invalid_image("unknown opcode");
+
+        // The operands each instruction pops, and the values it pushes
+        size_t pops = 2;
+        size_t pushes = 1;
+        switch (op) {
+        case OpCode::PUSH_CONSTANT:
+            if (operand >= record.constant_count)
+                throw_invalid_image("constant out of bounds");
+            pops = 0;
+            break;
+        case OpCode::LOAD_VARIABLE:
+            if (operand >= record.variable_count)
+                throw_invalid_image("variable out of bounds");
+            pops = 0;
+            break;
+        case OpCode::DUPLICATE:
+            pops = 1;
+            pushes = 2;
+            break;
+        case OpCode::NEGATE:
+        case OpCode::REQUIRE_NUMBER:
+        case OpCode::REQUIRE_BOOL:
+            pops = 1;
+            break;
+        case OpCode::JUMP_IF_FALSE:
+        case OpCode::JUMP_IF_TRUE: {
+            const size_t landing = index + 1 + operand;
+            if (depth == 0 || landing > record.code_size ||
+                (!landings.empty() && landing > landings.back().first))
+                throw_invalid_image("jump out of bounds");
+            landings.emplace_back(landing, depth);
+            pops = 1;
+            pushes = 0;
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (depth < pops)
+            throw_invalid_image("stack underflow");
+        depth = depth - pops + pushes;
+        if (depth > record.max_stack_depth)
+            throw_invalid_image("stack deeper than recorded");
+    }
+
+    if (depth != 1)
+        throw_invalid_image("program does not leave one value");
+}
+} // namespace
+
+std::string expression_evaluator::serialization::serialize(
+    std::span<const compiler::CompiledExpression> programs) {
+    std::string image(sizeof(ImageHeader) +
+                          programs.size() * sizeof(ProgramRecord),
+                      '\0');
+
+    for (size_t index = 0; index < programs.size(); index++) {
+        const compiler::CompiledExpression &program = programs[index];
+        ProgramRecord record{};
+
+        record.code_offset = image.size();
+        record.code_size = to_count(program.get_code().size());
+        for (const compiler::Instruction &instruction : program.get_code()) {
+            // The opcode's byte followed by 3 zero bytes
+            append(image, static_cast<std::uint32_t>(instruction.op));
+            append(image, instruction.operand);
+        }
+
+        record.constants_offset = image.size();
+        record.constant_count = to_count(program.get_constants().size());
+        for (const evaluator::Value &constant : program.get_constants())
+            append(image, std::bit_cast<std::uint64_t>(constant));
+
+        const std::vector<std::string> &variables = program.get_variables();
+        record.variables_offset = image.size();
+        record.variable_count = to_count(variables.size());
+        image.resize(image.size() + variables.size() * sizeof(VariableRecord));
+        for (size_t slot = 0; slot < variables.size(); slot++) {
+            const size_t offset =
+                record.variables_offset + slot * sizeof(VariableRecord);
+            store(image, offset + offsetof(VariableRecord, name_offset),
+                  std::uint64_t{image.size()});
+            store(image, offset + offsetof(VariableRecord, name_length),
+                  to_count(variables[slot].size()));
+            image += variables[slot];
+        }
+        align(image);
+
+        record.max_stack_depth = to_count(program.get_max_stack_depth());
+        store_record(image, sizeof(ImageHeader) + index * sizeof(ProgramRecord),
+                     record);
+    }
+
+    std::memcpy(image.data(), MAGIC, sizeof(MAGIC));
+    store(image, offsetof(ImageHeader, version), FORMAT_VERSION);
+    store(image, offsetof(ImageHeader, program_count),
+          to_count(programs.size()));
+    store(image, offsetof(ImageHeader, size), std::uint64_t{image.size()});
+    store(image, offsetof(ImageHeader, checksum), checksum(image));
+    return image;
+}
+
+expression_evaluator::serialization::ProgramView::ProgramView(
+    const char *image, const ProgramRecord &record)
+    : image(image),
+      code(reinterpret_cast<const compiler::Instruction *>(image +
+                                                           record.code_offset),
+           record.code_size),
+      constants(reinterpret_cast<const evaluator::Value *>(
+                    image + record.constants_offset),
+                record.constant_count),
+      variables_offset(record.variables_offset),
+      variable_count(record.variable_count),
+      max_stack_depth(record.max_stack_depth) {}
+
+std::string_view
+expression_evaluator::serialization::ProgramView::get_variable(
+    size_t slot) const noexcept {
+    assert(slot < variable_count);
+    VariableRecord record;
+    std::memcpy(&record, image + variables_offset + slot * sizeof(record),
+                sizeof(record));
+    return std::string_view(image + record.name_offset, record.name_length);
+}
+
+std::optional<size_t>
+expression_evaluator::serialization::ProgramView::find_variable(
+    std::string_view name) const noexcept {
+    for (size_t slot = 0; slot < variable_count; slot++)
+        if (get_variable(slot) == name)
+            return slot;
+
+    return std::nullopt;
+}
+
+expression_evaluator::serialization::ProgramImage::ProgramImage(
+    std::string_view bytes)
+    : image(bytes.data()), program_count(0) {
+    if constexpr (std::endian::native != std::endian::little)
+        throw std::runtime_error(
+            "Program images can only be read on little-endian hosts");
+
+    ImageHeader header;
+    if (bytes.size() < sizeof(header) ||
+        std::memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) != 0)
+        throw_invalid_image("not a program image");
+
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.version < OLDEST_FORMAT_VERSION ||
+        header.version > FORMAT_VERSION)
+        throw_invalid_image("unsupported version " +
+                            std::to_string(header.version));
+    if (header.size != bytes.size())
+        throw_invalid_image("expected " + std::to_string(header.size) +
+                            " bytes, got " + std::to_string(bytes.size()));
+    if (reinterpret_cast<std::uintptr_t>(bytes.data()) % 8 != 0)
+        throw_invalid_image("not aligned to 8 bytes");
+    if (checksum(bytes) != header.checksum)
+        throw_invalid_image("checksum mismatch");
+    if (header.program_count >
+        (bytes.size() - sizeof(header)) / sizeof(ProgramRecord))
+        throw_invalid_image("program table out of bounds");
+
+    std::vector<std::pair<size_t, size_t>> landings;
+    for (size_t index = 0; index < header.program_count; index++) {
+        ProgramRecord record;
+        std::memcpy(&record,
+                    bytes.data() + sizeof(header) + index * sizeof(record),
+                    sizeof(record));
+        check_program(bytes, header.version, record, landings);
+    }
+
+    program_count = header.program_count;
+}
+
+expression_evaluator::serialization::ProgramView
+expression_evaluator::serialization::ProgramImage::operator[](
+    size_t index) const noexcept {
+    assert(index < program_count);
+    ProgramRecord record;
+    std::memcpy(&record,
+                image + sizeof(ImageHeader) + index * sizeof(ProgramRecord),
+                sizeof(record));
+    return ProgramView(image, record);
+}
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <expression_evaluator/stats.hpp>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+using namespace expression_evaluator;
+using stats::Snapshot;
+using stats::StageStats;
+
+#ifndef EXPRESSION_EVALUATOR_NO_STATS
+/// @brief Add a snapshot's counters to another's, or subtract them
+void accumulate(Snapshot &total, const Snapshot &part, bool subtract = false) {
+    const auto combine = [subtract](std::uint64_t &sum, std::uint64_t value) {
+        sum = subtract ? sum - value : sum + value;
+    };
+
+    for (size_t index = 0; index < stats::STAGE_COUNT; index++) {
+        StageStats &stage = total.stages[index];
+        const StageStats &other = part.stages[index];
+        combine(stage.calls, other.calls);
+        combine(stage.tokens, other.tokens);
+        combine(stage.errors, other.errors);
+        combine(stage.allocations, other.allocations);
+        combine(stage.total_nanoseconds, other.total_nanoseconds);
+        for (size_t bucket = 0; bucket < stats::HISTOGRAM_BUCKETS; bucket++)
+            combine(stage.histogram[bucket], other.histogram[bucket]);
+    }
+    combine(total.exceptions, part.exceptions);
+}
+
+/// @brief A counter written only by the thread owning it, and read by any
+struct Counter {
+    std::atomic<std::uint64_t> value{0};
+
+    void add(std::uint64_t amount) noexcept {
+        value.store(value.load(std::memory_order_relaxed) + amount,
+                    std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] std::uint64_t get() const noexcept {
+        return value.load(std::memory_order_relaxed);
+    }
+};
+
+struct StageCounters {
+    Counter calls;
+    Counter tokens;
+    Counter errors;
+    Counter allocations;
+    Counter total_nanoseconds;
+    std::array<Counter, stats::HISTOGRAM_BUCKETS> histogram;
+};
+
+/// @brief The counters of one thread, so that threads never write to the
+/// same cache lines
+struct Shard {
+    std::array<StageCounters, stats::STAGE_COUNT> stages;
+    Counter exceptions;
+
+    [[nodiscard]] Snapshot read() const noexcept {
+        Snapshot snapshot;
+        for (size_t index = 0; index < stats::STAGE_COUNT; index++) {
+            StageStats &stage = snapshot.stages[index];
+            const StageCounters &counters = stages[index];
+            stage.calls = counters.calls.get();
+            stage.tokens = counters.tokens.get();
+            stage.errors = counters.errors.get();
+            stage.allocations = counters.allocations.get();
+            stage.total_nanoseconds = counters.total_nanoseconds.get();
+            for (size_t bucket = 0; bucket < stats::HISTOGRAM_BUCKETS;
+                 bucket++)
+                stage.histogram[bucket] = counters.histogram[bucket].get();
+        }
+        snapshot.exceptions = exceptions.get();
+        return snapshot;
+    }
+};
+
+/// @brief The shards of live threads, and the totals of exited ones
+struct Registry {
+    std::mutex mutex;
+    std::vector<const Shard *> shards;
+    Snapshot retired;
+    // Subtracted from every snapshot, see stats::reset()
+    Snapshot baseline;
+};
+
+Registry &registry() {
+    // Never destroyed, as threads may exit during static destruction
+    static Registry *const instance = new Registry;
+    return *instance;
+}
+
+/// @brief Registers the calling thread's shard on first use, and folds it
+/// into the retired totals when the thread exits
+class ShardOwner {
+  private:
+    Shard shard;
+
+  public:
+    ShardOwner() {
+        Registry &shared = registry();
+        const std::lock_guard lock(shared.mutex);
+        shared.shards.push_back(&shard);
+    }
+
+    ~ShardOwner() {
+        Registry &shared = registry();
+        const std::lock_guard lock(shared.mutex);
+        accumulate(shared.retired, shard.read());
+        std::erase(shared.shards, &shard);
+    }
+
+    ShardOwner(const ShardOwner &) = delete;
+    ShardOwner &operator=(const ShardOwner &) = delete;
+
+    Shard &get() noexcept { return shard; }
+};
+
+/// @brief Returns the calling thread's shard, or nullptr if it could not be
+/// registered, in which case nothing is recorded
+Shard *local_shard() noexcept {
+    try {
+        thread_local ShardOwner owner;
+        return &owner.get();
+    } catch (...) {
+        return nullptr;
+    }
+}
+#endif
+} // namespace
+
+double expression_evaluator::stats::StageStats::mean_nanoseconds()
+    const noexcept {
+    if (calls == 0)
+        return 0.0;
+
+    return static_cast<double>(total_nanoseconds) / static_cast<double>(calls);
+}
+
+std::uint64_t expression_evaluator::stats::StageStats::percentile_nanoseconds(
+    double fraction) const noexcept {
+    if (calls == 0)
+        return 0;
+
+    // The smallest bucket that, with the ones below it, holds the fraction
+    const double wanted = fraction * static_cast<double>(calls);
+    std::uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+        seen += histogram[bucket];
+        if (static_cast<double>(seen) >= wanted)
+            return std::uint64_t{1} << bucket;
+    }
+
+    return std::uint64_t{1} << (HISTOGRAM_BUCKETS - 1);
+}
+
+std::string expression_evaluator::stats::Snapshot::to_string() const {
+    std::string text;
+    char line[160];
+    std::snprintf(line, sizeof(line),
+                  "%-17s %10s %12s %8s %10s %12s %9s %9s %9s\n", "stage",
+                  "calls", "tokens", "errors", "allocs", "total ms", "mean ns",
+                  "p50 ns", "p99 ns");
+    text += line;
+
+    for (size_t index = 0; index < STAGE_COUNT; index++) {
+        const StageStats &stage = stages[index];
+        if (stage.calls == 0)
+            continue;
+
+        std::snprintf(
+            line, sizeof(line),
+            "%-17s %10llu %12llu %8llu %10llu %12.3f %9.0f %9llu %9llu\n",
+            stage_name(static_cast<Stage>(index)),
+            static_cast<unsigned long long>(stage.calls),
+            static_cast<unsigned long long>(stage.tokens),
+            static_cast<unsigned long long>(stage.errors),
+            static_cast<unsigned long long>(stage.allocations),
+            static_cast<double>(stage.total_nanoseconds) / 1e6,
+            stage.mean_nanoseconds(),
+            static_cast<unsigned long long>(stage.percentile_nanoseconds(0.5)),
+            static_cast<unsigned long long>(
+                stage.percentile_nanoseconds(0.99)));
+        text += line;
+    }
+
+    text += "exceptions thrown: " + std::to_string(exceptions) + "\n";
+    return text;
+}
+
+const char *expression_evaluator::stats::stage_name(Stage stage) noexcept {
+    switch (stage) {
+    case Stage::TOKENIZE:
+        return "tokenize";
+    case Stage::TO_POSTFIX:
+        return "to_postfix";
+    case Stage::EVALUATE_POSTFIX:
+        return "evaluate_postfix";
+    case Stage::EVALUATE:
+        return "evaluate";
+    case Stage::COMPILE:
+        return "compile";
+    case Stage::EXECUTE:
+        return "execute";
+    default:
+        return "unknown";
+    }
+}
+
+#ifndef EXPRESSION_EVALUATOR_NO_STATS
+void expression_evaluator::stats::set_enabled(bool enabled) noexcept {
+    detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+expression_evaluator::stats::Snapshot expression_evaluator::stats::snapshot() {
+    Registry &shared = registry();
+    const std::lock_guard lock(shared.mutex);
+
+    Snapshot total = shared.retired;
+    for (const Shard *shard : shared.shards)
+        accumulate(total, shard->read());
+    accumulate(total, shared.baseline, true);
+    return total;
+}
+
+void expression_evaluator::stats::reset() {
+    // Owners keep writing their shards, so later snapshots subtract what has
+    // been counted so far instead
+    Snapshot counted = snapshot();
+    Registry &shared = registry();
+    const std::lock_guard lock(shared.mutex);
+    accumulate(shared.baseline, counted);
+}
+
+void expression_evaluator::stats::detail::note_exception() noexcept {
+    if (!is_enabled())
+        return;
+
+    if (Shard *shard = local_shard())
+        shard->exceptions.add(1);
+}
+
+void expression_evaluator::stats::detail::StageTimer::record() noexcept {
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    const auto nanoseconds =
+        static_cast<std::uint64_t>(std::max(elapsed.count(), std::int64_t{0}));
+    const size_t bucket =
+        std::min(static_cast<size_t>(std::bit_width(nanoseconds)),
+                 HISTOGRAM_BUCKETS - 1);
+
+    Shard *shard = local_shard();
+    if (shard == nullptr)
+        return;
+
+    StageCounters &counters = shard->stages[static_cast<size_t>(stage)];
+    counters.calls.add(1);
+    counters.tokens.add(tokens);
+    counters.errors.add(failed ? 1 : 0);
+    counters.allocations.add(allocation_count - start_allocations);
+    counters.total_nanoseconds.add(nanoseconds);
+    counters.histogram[bucket].add(1);
+}
+#else
+void expression_evaluator::stats::set_enabled(bool) noexcept {}
+
+expression_evaluator::stats::Snapshot expression_evaluator::stats::snapshot() {
+    return Snapshot{};
+}
+
+void expression_evaluator::stats::reset() {}
+#endif
@@ -0,0 +1,273 @@
+#include <expression_evaluator/compiler.hpp>
+#include <expression_evaluator/evaluator.hpp>
+#include <expression_evaluator/lexer.hpp>
+#include <expression_evaluator/parser.hpp>
+#include <expression_evaluator/stats.hpp>
+#include <expression_evaluator/structures/queue.hpp>
+#include <expression_evaluator/structures/stack.hpp>
+#include <expression_evaluator/token.hpp>
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Count every call to the global allocation functions made by this program,
+// and the bytes requested
+namespace {
+size_t allocation_count = 0;
+size_t allocated_bytes = 0;
+
+void *counted_allocate(size_t size, size_t alignment) {
+    allocation_count++;
+    allocated_bytes += size;
+
+    void *memory = alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__
+                       ? std::malloc(size == 0 ? 1 : size)
+                       : std::aligned_alloc(
+                             alignment, (size + alignment - 1) / alignment *
+                                            alignment);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+
+    return memory;
+}
+} // namespace
+
+void *operator new(size_t size) {
+    return counted_allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void *operator new[](size_t size) {
+    return counted_allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void *operator new(size_t size, std::align_val_t alignment) {
+    return counted_allocate(size, static_cast<size_t>(alignment));
+}
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return counted_allocate(size, static_cast<size_t>(alignment));
+}
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, size_t) noexcept { std::free(memory); }
+void operator delete(void *memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+void operator delete[](void *memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+void operator delete(void *memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+void operator delete[](void *memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+using expression_evaluator::Token;
+using expression_evaluator::TokenQueue;
+using expression_evaluator::evaluator::Value;
+using expression_evaluator::structures::HeapAllocator;
+using expression_evaluator::structures::Queue;
+using expression_evaluator::structures::Stack;
+namespace compiler = expression_evaluator::compiler;
+namespace evaluator = expression_evaluator::evaluator;
+namespace lexer = expression_evaluator::lexer;
+namespace parser = expression_evaluator::parser;
+namespace stats = expression_evaluator::stats;
+
+#ifndef EXPRESSION_EVALUATOR_CONTIGUOUS_CONTAINERS
+constexpr bool CONTIGUOUS = false;
+#else
+constexpr bool CONTIGUOUS = true;
+#endif
+
+/// @brief Counts the allocations made between its creation and each call to
+/// count() or bytes()
+class AllocationScope {
+  private:
+    size_t start_count = allocation_count;
+    size_t start_bytes = allocated_bytes;
+
+  public:
+    [[nodiscard]] size_t count() const noexcept {
+        return allocation_count - start_count;
+    }
+    [[nodiscard]] size_t bytes() const noexcept {
+        return allocated_bytes - start_bytes;
+    }
+};
+
+[[maybe_unused]] Value eval(std::string_view expression) {
+    TokenQueue infix;
+    lexer::tokenize(expression, infix);
+
+    TokenQueue postfix;
+    parser::to_postfix(infix, postfix);
+
+    return evaluator::evaluate_expression(postfix);
+}
+
+/// @brief Run fn once to warm up any pools, then check that running it again
+/// makes exactly the expected number of global allocations. Budgets are
+/// exact, so that both new allocations and removed ones are noticed (and the
+/// budget lowered)
+template <typename Fn>
+void expect_allocations(std::string_view name, size_t budget, Fn &&fn) {
+    fn();
+
+    const AllocationScope scope;
+    fn();
+    const size_t allocations = scope.count();
+
+    if (allocations != budget)
+        throw std::runtime_error(
+            std::string(name) + " made " + std::to_string(allocations) +
+            " allocations (" + std::to_string(scope.bytes()) +
+            " bytes) in steady state, expected " + std::to_string(budget));
+}
+
+/// @brief Check that running fn again after warming up makes no global
+/// allocations
+template <typename Fn>
+void expect_no_steady_state_allocations(std::string_view name, Fn &&fn) {
+    expect_allocations(name, 0, std::forward<Fn>(fn));
+}
+} // namespace
+
+int main() {
+    try {
+        // The heap allocator must be visible to the counter, or the checks
+        // below prove nothing
+        {
+            const AllocationScope scope;
+            Stack<int, HeapAllocator> stack;
+            for (int i = 0; i < 10; i++)
+                stack.push(i);
+
+            if (scope.count() != 10 || scope.bytes() < 10 * sizeof(int))
+                throw std::runtime_error("Allocation counter is not working");
+        }
+
+        expect_no_steady_state_allocations("pooled queue", []() {
+            Queue<Token> queue;
+            for (int i = 0; i < 100; i++)
+                queue.enqueue(Token::from_integer(i));
+            while (!queue.is_empty())
+                (void)queue.dequeue();
+        });
+
+        // A long expression mixing every kind of token
+        const std::string_view expression =
+            "((1 + 2.5) * 3 - -4 / 2) ^ 2 > 10 && (7 <= 8 || false) && "
+            "(true != false) == (1 >= 0.5) || 2 * (3 + (4 * (5 - 6))) < 1";
+
+        // Contiguous containers own their buffers, so only the pooled linked
+        // lists make the whole pipeline allocation-free
+#ifndef EXPRESSION_EVALUATOR_CONTIGUOUS_CONTAINERS
+        // Literals longer than any small-string buffer
+        expect_no_steady_state_allocations("tokenize", []() {
+            TokenQueue tokens;
+            lexer::tokenize("3.14159265358979323846264338 * "
+                            "123456789012345678 + long_variable_name",
+                            tokens);
+        });
+
+        expect_no_steady_state_allocations(
+            "tokenize/to_postfix/evaluate_expression",
+            [&]() { (void)eval(expression); });
+        expect_no_steady_state_allocations(
+            "evaluate", [&]() { (void)evaluator::evaluate(expression); });
+#else
+        (void)expression;
+#endif
+
+        // Exact budgets for each stage of the pipeline, run on queues that
+        // are reused as they would be in a loop over many expressions. The
+        // contiguous containers allocate the stacks of to_postfix and
+        // evaluate_expression on every call
+        const std::string_view representative[] = {
+            "1 + 2 * 3",
+            "(10 - 4) / 3 >= 2 && 7 - 4 == 3 || false",
+            "123456789012345678 * 3.14159265358979323846264338 - 0.5 ^ 2",
+        };
+        for (const std::string_view text : representative) {
+            TokenQueue infix;
+            TokenQueue postfix;
+            const std::string name(text);
+
+            expect_allocations("tokenize " + name, 0, [&]() {
+                lexer::tokenize(text, infix);
+                while (!infix.is_empty())
+                    (void)infix.dequeue();
+            });
+            expect_allocations("to_postfix " + name, CONTIGUOUS ? 2 : 0,
+                               [&]() {
+                                   lexer::tokenize(text, infix);
+                                   parser::to_postfix(infix, postfix);
+                                   while (!postfix.is_empty())
+                                       (void)postfix.dequeue();
+                               });
+            expect_allocations("evaluate_expression " + name,
+                               CONTIGUOUS ? 5 : 0, [&]() {
+                                   lexer::tokenize(text, infix);
+                                   parser::to_postfix(infix, postfix);
+                                   (void)evaluator::evaluate_expression(
+                                       postfix);
+                               });
+            expect_allocations("evaluate " + name, CONTIGUOUS ? 5 : 0, [&]() {
+                (void)evaluator::evaluate(text);
+            });
+        }
+
+        // Errors are returned without allocating; only thrown ones format
+        // their message. The budgets are those of the contiguous containers,
+        // which stop allocating where the error is found
+        const std::pair<std::string_view, size_t> errors[] = {
+            {"1 / 0", 3},
+            {"1 + * 2", 4},
+            {"x + 1", 0},
+        };
+        for (const auto &[text, contiguous_budget] : errors)
+            expect_allocations("try_evaluate " + std::string(text),
+                               CONTIGUOUS ? contiguous_budget : 0, [&]() {
+                                   (void)evaluator::try_evaluate(text);
+                               });
+
+        // Recording stats allocates only when a thread first records
+        stats::set_enabled(true);
+        expect_allocations("evaluate with stats", CONTIGUOUS ? 8 : 0,
+                           [&]() { (void)evaluator::evaluate(expression); });
+        stats::set_enabled(false);
+
+        // The std::ostringstream and its buffer
+        expect_allocations("Value::to_string of a number", 2, []() {
+            (void)Value{0.1}.to_string();
+        });
+        expect_no_steady_state_allocations("Value::to_string of a boolean",
+                                           []() {
+                                               (void)Value{true}.to_string();
+                                           });
+
+        const compiler::CompiledExpression program =
+            compiler::compile("price * qty > limit");
+        const Value bindings[] = {Value{2.5}, Value{4}, Value{9}};
+        // Every compile builds a new program, with its own instructions,
+        // constants and variable names
+        expect_allocations("compile", CONTIGUOUS ? 12 : 9, []() {
+            (void)compiler::compile("price * qty > limit");
+        });
+        expect_no_steady_state_allocations(
+            "CompiledExpression::evaluate",
+            [&]() { (void)program.evaluate(bindings); });
+
+        return 0;
+    } catch (const std::exception &e) {
+        std::cerr << "TEST FAILED: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,100 @@
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+
+// Runs the command line tool, whose path is the first argument, in both of
+// its modes over the same lines
+namespace {
+std::string read_file(const std::filesystem::path &path) {
+    std::ifstream stream(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(stream), {});
+}
+
+/// @brief A file in the temporary directory whose name is unique to this
+/// process, removed when it goes out of scope
+class TemporaryFile {
+  private:
+    std::filesystem::path path;
+
+  public:
+    explicit TemporaryFile(const std::string &name)
+        : path(std::filesystem::temp_directory_path() /
+               ("expression_evaluator_cli_" + std::to_string(::getpid()) +
+                "_" + name)) {}
+    ~TemporaryFile() {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    }
+
+    TemporaryFile(const TemporaryFile &) = delete;
+    TemporaryFile &operator=(const TemporaryFile &) = delete;
+
+    [[nodiscard]] const std::filesystem::path &get_path() const noexcept {
+        return path;
+    }
+};
+
+/// @brief Run the tool with arguments and the input file as standard input
+/// @return Everything it wrote to standard output and error
+std::string run(const std::string &program, const std::string &arguments,
+                const std::filesystem::path &input) {
+    const TemporaryFile output("output.txt");
+    const std::string command = "\"" + program + "\" " + arguments + " < \"" +
+                                input.string() + "\" > \"" +
+                                output.get_path().string() + "\" 2>&1";
+    if (std::system(command.c_str()) != 0)
+        throw std::runtime_error("Command failed: " + command);
+
+    return read_file(output.get_path());
+}
+
+void expect_output(const std::string &name, const std::string &written,
+                   const std::string &expected) {
+    if (written != expected)
+        throw std::runtime_error(name + ": expected \"" + expected +
+                                 "\", got \"" + written + "\"");
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    try {
+        if (argc != 2)
+            throw std::runtime_error("Usage: test_cli EXECUTABLE");
+        const std::string program = argv[1];
+
+        const TemporaryFile input("input.txt");
+        std::ofstream(input.get_path(), std::ios::binary)
+            << "false && 1 / 0 > 0\ntrue && 1 / 0 > 0\n1 / 0 + $\n1 + 2\n"
+               "false && x\n1 + 2\n";
+
+        // Both modes short-circuit && and ||, as compiled programs do,
+        // report lexing errors before evaluation errors, and report variables
+        // as unbound even where the REPL's optimized program drops them.
+        // The REPL evaluates a repeated line from its cache
+        const std::string batch =
+            run(program, "--batch --threads 1", input.get_path());
+        const std::string interactive = run(program, "", input.get_path());
+
+        expect_output("--batch", batch,
+                      "false\nerror: Math error: division by zero\nerror: "
+                      "Unexpected character: '$'\n3\nerror: Unbound "
+                      "variable: x\n3\n");
+        const std::string prompts =
+            "> false\n> Math error: division by zero\n> Unexpected "
+            "character: '$'\n> 3\n> Unbound variable: x\n> 3\n> ";
+        expect_output("interactive", interactive.substr(interactive.find("> ")),
+                      prompts);
+
+        return 0;
+    } catch (const std::exception &e) {
+        std::cerr << "TEST FAILED: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -1,32 +1,77 @@
+#include <expression_evaluator/batch.hpp>
+#include <expression_evaluator/cache.hpp>
+#include <expression_evaluator/columnar.hpp>
+#include <expression_evaluator/compiler.hpp>
+#include <expression_evaluator/error.hpp>
 #include <expression_evaluator/evaluator.hpp>
+#include <expression_evaluator/expression_set.hpp>
+#include <expression_evaluator/graph.hpp>
 #include <expression_evaluator/lexer.hpp>
+#include <expression_evaluator/mapped_file.hpp>
 #include <expression_evaluator/parser.hpp>
-#include <expression_evaluator/structures/queue.hpp>
+#include <expression_evaluator/serialization.hpp>
+#include <expression_evaluator/static_expression.hpp>
+#include <expression_evaluator/stats.hpp>
 #include <expression_evaluator/token.hpp>
 
+#include <array>
+#include <bit>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <exception>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <span>
 #include <sstream>
+#include <string>
 #include <string_view>
+#include <type_traits>
+#include <vector>
 
 namespace {
-using expression_evaluator::Token;
+using expression_evaluator::ErrorCode;
+using expression_evaluator::MappedFile;
+using expression_evaluator::Result;
+using expression_evaluator::TokenQueue;
 using expression_evaluator::evaluator::Value;
-using expression_evaluator::structures::Queue;
+namespace batch = expression_evaluator::batch;
+namespace cache = expression_evaluator::cache;
+namespace columnar = expression_evaluator::columnar;
+namespace compiler = expression_evaluator::compiler;
 namespace evaluator = expression_evaluator::evaluator;
+namespace expression_set = expression_evaluator::expression_set;
+namespace graph = expression_evaluator::graph;
 namespace lexer = expression_evaluator::lexer;
 namespace parser = expression_evaluator::parser;
+namespace serialization = expression_evaluator::serialization;
+namespace static_expression = expression_evaluator::static_expression;
+namespace stats = expression_evaluator::stats;
+using namespace static_expression::literals;
 
 Value eval(std::string_view expression) {
-    Queue<Token> infix;
+    TokenQueue infix;
     lexer::tokenize(expression, infix);
 
-    Queue<Token> postfix;
+    TokenQueue postfix;
     parser::to_postfix(infix, postfix);
 
-    return evaluator::evaluate_expression(postfix);
+    const Value result = evaluator::evaluate_expression(postfix);
+
+    // The fused streaming pipeline must agree with the queue-based one
+    const Value streamed = evaluator::evaluate(expression);
+    if (streamed.to_string() != result.to_string())
+        throw std::runtime_error("Streaming result for '" +
+                                 std::string(expression) + "' was " +
+                                 streamed.to_string() + ", expected " +
+                                 result.to_string());
+
+    return result;
 }
 
 void expect_number(std::string_view expression, double expected,
@@ -64,6 +109,232 @@ void expect_bool(std::string_view expression, bool expected) {
     }
 }
 
+void expect_same_compiled(std::string_view expression) {
+    const compiler::CompiledExpression program = compiler::compile(expression);
+    const Value expected = eval(expression);
+
+    // Evaluate repeatedly, and through a copy, to make sure the program is
+    // not consumed by evaluation
+    const compiler::CompiledExpression copy = program;
+    for (const compiler::CompiledExpression *p : {&program, &copy, &program}) {
+        const Value actual = p->evaluate();
+        if (actual.to_string() != expected.to_string()) {
+            throw std::runtime_error("Compiled result for '" +
+                                     std::string(expression) + "' was " +
+                                     actual.to_string() + ", expected " +
+                                     expected.to_string());
+        }
+    }
+}
+
+void expect_same_columnar(std::string_view expression,
+                          const compiler::CompiledExpression &program) {
+    // Enough rows to cover full vector blocks and a scalar tail, including
+    // zeros, negatives and NaN
+    constexpr size_t rows = 1037;
+    std::vector<double> x(rows), y(rows);
+    for (size_t row = 0; row < rows; row++) {
+        x[row] = static_cast<double>(row % 17) - 8.0;
+        y[row] = row % 101 == 0 ? std::nan("")
+                                : static_cast<double>(row) / 7.0 + 1.0;
+    }
+
+    const double *columns[] = {x.data(), y.data()};
+
+    for (const columnar::KernelSet kernels :
+         {columnar::KernelSet::SCALAR, columnar::KernelSet::SSE2,
+          columnar::KernelSet::AVX2}) {
+        if (!columnar::is_supported(kernels))
+            continue;
+
+        std::vector<double> output(rows);
+        const columnar::ColumnType type =
+            columnar::evaluate(program, columns, rows, output.data(), kernels);
+
+        for (size_t row = 0; row < rows; row++) {
+            const Value bindings[] = {Value{x[row]}, Value{y[row]}};
+            const Value expected = program.evaluate(bindings);
+            const double expected_number =
+                expected.is_bool() ? (expected.as_bool() ? 1.0 : 0.0)
+                                   : expected.as_number();
+
+            const bool same = std::isnan(expected_number)
+                                  ? std::isnan(output[row])
+                                  : output[row] == expected_number;
+            if (!same || (type == columnar::ColumnType::BOOLEAN) !=
+                             expected.is_bool())
+                throw std::runtime_error("Columnar result for '" +
+                                         std::string(expression) +
+                                         "' differs at row " +
+                                         std::to_string(row));
+        }
+    }
+}
+
+void expect_same_columnar(std::string_view expression) {
+    const compiler::CompiledExpression program = compiler::compile(expression);
+    expect_same_columnar(expression, program);
+    expect_same_columnar(expression, compiler::optimize(program));
+}
+
+/// @brief Returns the tokens of an expression, ending with its error if it
+/// has one, as text
+std::string scan(std::string_view expression, lexer::Scanner scanner) {
+    using expression_evaluator::TokenType;
+
+    lexer::Lexer lexer(expression, scanner);
+    std::string tokens;
+    while (true) {
+        Result<std::optional<expression_evaluator::Token>> next =
+            lexer.try_next();
+        if (!next)
+            return tokens + "error " + next.get_error().message() + " at " +
+                   std::to_string(next.get_error().get_source_offset().value_or(
+                       UINT32_MAX));
+        if (!next.value())
+            return tokens;
+
+        const expression_evaluator::Token &token = *next.value();
+        tokens += std::to_string(static_cast<int>(token.type)) + ':';
+        if (token.type == TokenType::IDENTIFIER)
+            tokens += std::to_string(token.get_name().data() -
+                                     expression.data()) +
+                      '+' + std::to_string(token.get_name().size());
+        else if (token.type == TokenType::INTEGER)
+            tokens += std::to_string(token.get_integer());
+        else if (token.type == TokenType::FLOAT)
+            tokens +=
+                std::to_string(std::bit_cast<std::uint64_t>(token.get_float()));
+        else
+            tokens += std::to_string(token.get_source_offset());
+        tokens += ' ';
+    }
+}
+
+/// @brief Check that every scanner the CPU supports splits the expression
+/// into the same tokens, or fails the same way, as the scalar one
+void expect_same_scanned(std::string_view expression) {
+    const std::string expected = scan(expression, lexer::Scanner::SCALAR);
+    for (const lexer::Scanner scanner :
+         {lexer::Scanner::SSE2, lexer::Scanner::AVX2}) {
+        if (!lexer::is_supported(scanner))
+            continue;
+
+        const std::string actual = scan(expression, scanner);
+        if (actual != expected)
+            throw std::runtime_error(
+                "Scanner " + std::to_string(static_cast<int>(scanner)) +
+                " tokenized '" + std::string(expression) + "' as " + actual +
+                ", expected " + expected);
+    }
+}
+
+/// @brief Returns the result of evaluating the program, or its error message
+std::string outcome(const compiler::CompiledExpression &program,
+                    std::span<const Value> bindings) {
+    try {
+        return program.evaluate(bindings).to_string();
+    } catch (const std::exception &e) {
+        return std::string("error: ") + e.what();
+    }
+}
+
+void expect_same_optimized(std::string_view expression,
+                           size_t expected_removed) {
+    const compiler::CompiledExpression program = compiler::compile(expression);
+    compiler::OptimizationStats stats;
+    const compiler::CompiledExpression optimized =
+        compiler::optimize(program, stats);
+
+    if (stats.removed_instructions() != expected_removed ||
+        optimized.get_code().size() != stats.instructions_after)
+        throw std::runtime_error(
+            "Optimizing '" + std::string(expression) + "' removed " +
+            std::to_string(stats.removed_instructions()) +
+            " instructions, expected " + std::to_string(expected_removed));
+
+    // Every combination of these values for up to two variables, so that
+    // both results and errors are compared
+    const Value candidates[] = {Value{0.0},  Value{-0.0},        Value{1.0},
+                                Value{-2.5}, Value{std::nan("")}, Value{true},
+                                Value{false}};
+    const size_t variable_count = program.get_variables().size();
+    size_t combinations = 1;
+    for (size_t variable = 0; variable < variable_count; variable++)
+        combinations *= std::size(candidates);
+
+    for (size_t combination = 0; combination < combinations; combination++) {
+        const Value bindings[] = {
+            candidates[combination % std::size(candidates)],
+            candidates[combination / std::size(candidates)]};
+        const std::span<const Value> used(bindings, variable_count);
+
+        if (outcome(optimized, used) != outcome(program, used))
+            throw std::runtime_error("Optimized result for '" +
+                                     std::string(expression) + "' was '" +
+                                     outcome(optimized, used) +
+                                     "', expected '" + outcome(program, used) +
+                                     "'");
+    }
+}
+
+/// @brief Check that expressions evaluated together in an ExpressionSet give
+/// the results and errors they give when evaluated separately, for every
+/// combination of values of x and y
+void expect_same_set(std::span<const std::string_view> expressions) {
+    expression_set::ExpressionSet set;
+    for (const std::string_view expression : expressions)
+        (void)set.add(expression);
+
+    const Value candidates[] = {Value{0.0}, Value{2.0}, Value{-2.5},
+                                Value{true}, Value{false}};
+    std::vector<Result<Value>> results(set.size(), Value{0.0});
+    for (const Value x : candidates)
+        for (const Value y : candidates) {
+            std::vector<Value> bindings(set.get_variables().size(), x);
+            if (const std::optional<size_t> slot = set.find_variable("y"))
+                bindings[*slot] = y;
+            set.try_evaluate(bindings, results);
+
+            for (size_t index = 0; index < expressions.size(); index++) {
+                const compiler::CompiledExpression program =
+                    compiler::compile(expressions[index]);
+                std::vector<Value> program_bindings;
+                for (const std::string &name : program.get_variables())
+                    program_bindings.push_back(name == "x" ? x : y);
+
+                const std::string shared =
+                    results[index] ? results[index].value().to_string()
+                                   : "error: " +
+                                         results[index].get_error().message();
+                if (shared != outcome(program, program_bindings))
+                    throw std::runtime_error(
+                        "Shared result for '" +
+                        std::string(expressions[index]) + "' was '" + shared +
+                        "', expected '" + outcome(program, program_bindings) +
+                        "'");
+            }
+        }
+}
+
+/// @brief Check that an expression compiled at compile time evaluates like
+/// the same expression compiled at runtime
+template <static_expression::ExpressionText text, typename... Numbers>
+void expect_same_static(Numbers... values) {
+    const auto expression = static_expression::compile<text>();
+    const std::array<Value, sizeof...(Numbers)> bindings{
+        Value{static_cast<double>(values)}...};
+
+    const std::string expected =
+        compiler::compile(text.view()).evaluate(bindings).to_string();
+    const std::string actual =
+        Value{expression.evaluate(values...)}.to_string();
+    if (actual != expected)
+        throw std::runtime_error("Static result for '" +
+                                 std::string(text.view()) + "' was " + actual +
+                                 ", expected " + expected);
+}
+
 template <typename Fn> void expect_throws(std::string_view name, Fn &&fn) {
     try {
         fn();
@@ -74,6 +345,35 @@ template <typename Fn> void expect_throws(std::string_view name, Fn &&fn) {
     throw std::runtime_error("Expected exception: " + std::string(name));
 }
 
+/// @brief Check the error try_evaluate returns, and that evaluate throws
+/// its message
+void expect_error(std::string_view expression, ErrorCode code,
+                  std::optional<std::uint32_t> offset) {
+    const Result<Value> result = evaluator::try_evaluate(expression);
+    if (result)
+        throw std::runtime_error("Expected error for '" +
+                                 std::string(expression) + "'");
+
+    const expression_evaluator::Error &error = result.get_error();
+    if (error.get_code() != code || error.get_source_offset() != offset)
+        throw std::runtime_error("Wrong error for '" + std::string(expression) +
+                                 "': " + error.message());
+
+    try {
+        (void)evaluator::evaluate(expression);
+    } catch (const std::exception &e) {
+        if (error.message() != e.what())
+            throw std::runtime_error("Error message for '" +
+                                     std::string(expression) + "' was '" +
+                                     error.message() + "', thrown '" +
+                                     e.what() + "'");
+        return;
+    }
+
+    throw std::runtime_error("Expected exception for '" +
+                             std::string(expression) + "'");
+}
+
 } // namespace
 
 int main() {
@@ -87,6 +387,47 @@ int main() {
         expect_number("1 + 2 * 3", 7.0);
         expect_number("(1 + 2) * 3", 9.0);
         expect_number("2 ^ 3 ^ 2", 512.0);
+        // Integer powers are exact up to 2^53, and other powers are std::pow's
+        expect_number("3 ^ 33", 5559060566555523.0, 0.0);
+        expect_number("(0 - 2) ^ 5", -32.0, 0.0);
+        expect_number("1.5 ^ 3", 3.375, 0.0);
+        expect_number("0.1 ^ 2", std::pow(0.1, 2.0), 0.0);
+        expect_number("1.1 ^ 3", std::pow(1.1, 3.0), 0.0);
+        static_assert(evaluator::power(2, 10) == 1024.0);
+        static_assert(evaluator::power(-3, 3) == -27.0);
+        if (evaluator::power(10, 22) != std::pow(10.0, 22.0) ||
+            evaluator::power(2, -1) != 0.5 ||
+            !std::signbit(evaluator::power(-0.0, 5)) ||
+            std::signbit(evaluator::power(-0.0, 6)) ||
+            evaluator::power(std::nan(""), 0) != 1.0 ||
+            !std::isnan(evaluator::power(std::nan(""), 7)))
+            throw std::runtime_error("Wrong integer power");
+
+        expect_number("3000000000 + 1", 3000000001.0);
+        expect_number("99999999999999999999", 1e20, 1e5);
+        // Integer literals stay exact in int64, and a result that does not
+        // fit is computed in double from its operands instead
+        expect_number("9007199254740993 - 9007199254740992", 1.0, 0.0);
+        expect_bool("9007199254740993 > 9007199254740992", true);
+        expect_bool("2 ^ 53 + 1 == 2 ^ 53", false);
+        expect_number("2 ^ 62 - (2 ^ 62 - 1)", 1.0, 0.0);
+        expect_number("2 ^ 63 - (2 ^ 63 - 1)", 0.0, 0.0);
+        expect_number("9223372036854775807 + 1 - 9223372036854775807", 0.0,
+                      0.0);
+        expect_number("-9223372036854775807 - 1 + 1", -9223372036854775807.0);
+        expect_number("(2 ^ 53 + 1) * 1.0 - 2 ^ 53", 0.0, 0.0);
+        expect_number("2 ^ (0 - 1)", 0.5);
+        expect_bool("3 ^ 39 == 4052555153018976267", true);
+        for (const std::string_view expression : {"-0", "0 * -5", "-(1 - 1)"})
+            if (!std::signbit(eval(expression).as_number()))
+                throw std::runtime_error("Expected -0 for '" +
+                                         std::string(expression) + "'");
+        for (const std::string_view expression :
+             {"9007199254740993 - 9007199254740992", "2 ^ 63 - (2 ^ 63 - 1)",
+              "-9223372036854775807 - 1 < -(2 ^ 62) * 2", "0 * -5"})
+            expect_same_compiled(expression);
+        expect_number("5. + .25", 5.25);
+        expect_number("\t1 +\n2\r", 3.0);
 
         expect_number("-2^2", -4.0);
         expect_number("-(1 + 2)", -3.0);
@@ -107,6 +448,797 @@ int main() {
         expect_bool("false || false", false);
         expect_bool("true && true", true);
 
+        {
+            // Numbers whose bits look like a boxed boolean stay numbers
+            const Value tagged{std::bit_cast<double>(~0ull)};
+            if (!tagged.is_number() || !std::isnan(tagged.as_number()) ||
+                !Value{true}.as_bool() || Value{false}.as_bool() ||
+                !Value{-std::nan("")}.is_number() ||
+                !std::signbit(Value{-0.0}.as_number()))
+                throw std::runtime_error("Wrong boxed value");
+        }
+
+        {
+            // Runs of every length up to two AVX2 registers, starting at
+            // every offset within one, and ending at the end of the text or
+            // before characters next to the classes' ranges
+            const std::string_view runs[] = {" ", "\t\n\v\f\r", "7",
+                                             "x_Z9", "1.25"};
+            const std::string_view endings[] = {
+                "",   "+1", "\x08", "\x0e", "/",    ":",   "@",
+                "[",  "`",  "{",   "\xc3\xa9", ".", "..5", "\x7f"};
+            const size_t offsets[] = {0, 1, 15, 16, 31};
+            for (const std::string_view run : runs)
+                for (size_t length = 0; length <= 64; length++) {
+                    std::string repeated;
+                    while (repeated.size() < length)
+                        repeated += run;
+                    repeated.resize(length);
+
+                    for (const size_t offset : offsets)
+                        for (const std::string_view ending : endings) {
+                            const std::string lead(offset, ' ');
+                            expect_same_scanned(lead + "a" + repeated +
+                                                std::string(ending));
+                            expect_same_scanned(lead + repeated +
+                                                std::string(ending));
+                        }
+                }
+
+            expect_same_scanned("12345678901234567890123 * .5 + true_ - "
+                                "false && truex || 3.14159265358979323846");
+            expect_same_scanned("  1.2.3");
+            if (!scan("  1.2.3", lexer::Scanner::SCALAR).ends_with(" at 2"))
+                throw std::runtime_error("Wrong scanner error");
+            if (!lexer::is_supported(lexer::Scanner::SCALAR) ||
+                !lexer::is_supported(lexer::best_scanner()))
+                throw std::runtime_error("Unsupported best scanner");
+        }
+
+        {
+            // Tokens record where they start; identifiers point at their name
+            const std::string_view expression = "12 + rate * -4.5 >= true";
+            TokenQueue tokens;
+            lexer::tokenize(expression, tokens);
+
+            const std::uint32_t offsets[] = {0, 3, 0, 10, 12, 13, 17, 20};
+            for (const std::uint32_t offset : offsets) {
+                const expression_evaluator::Token token = tokens.dequeue();
+                const bool matches =
+                    token.type == expression_evaluator::TokenType::IDENTIFIER
+                        ? token.get_name() == "rate" &&
+                              token.get_name().data() == expression.data() + 5
+                        : token.get_source_offset() == offset;
+                if (!matches)
+                    throw std::runtime_error("Wrong token position");
+            }
+        }
+
+        expect_same_compiled("1 + 2 * 3");
+        expect_same_compiled("2 ^ 3 ^ 2");
+        expect_same_compiled("-(1 + 2) * .5");
+        expect_same_compiled("(3 > 2) == (1 != 1) || true && false");
+        expect_same_compiled("(1 < 2 || 3 > 4) && (true || 1 > 2)");
+        {
+            // Deeper than the interpreter's inline stack
+            std::string nested = "1";
+            for (int depth = 0; depth < 200; depth++)
+                nested = std::to_string(depth) + " - (" + nested + ")";
+            expect_same_compiled(nested);
+        }
+
+        {
+            const compiler::CompiledExpression program =
+                compiler::compile("price * qty > limit || price == 0");
+            if (program.get_variables() !=
+                std::vector<std::string>{"price", "qty", "limit"})
+                throw std::runtime_error("Unexpected variable slots");
+
+            const Value row1[] = {Value{2.5}, Value{4}, Value{9}};
+            const Value row2[] = {Value{2.5}, Value{4}, Value{10}};
+            if (!program.evaluate(row1).as_bool() ||
+                program.evaluate(row2).as_bool())
+                throw std::runtime_error("Wrong result with bindings");
+
+            const std::string_view layout[] = {"limit", "qty", "price"};
+            const compiler::CompiledExpression fixed =
+                compiler::compile("price * qty", layout);
+            const Value row3[] = {Value{0}, Value{3}, Value{1.5}};
+            if (fixed.find_variable("price") != 2u ||
+                fixed.evaluate(row3).as_number() != 4.5)
+                throw std::runtime_error("Wrong result with fixed layout");
+        }
+
+        {
+            // && and || skip their right operand, errors included, when the
+            // left one decides the result
+            const compiler::CompiledExpression program =
+                compiler::compile("x != 0 && 1 / x > 2 || y");
+            const Value zero[] = {Value{0}, Value{true}};
+            const Value small[] = {Value{0.25}, Value{1}};
+            if (!program.evaluate(zero).as_bool() ||
+                !program.evaluate(small).as_bool() ||
+                !compiler::compile("true || 1 / 0").evaluate().as_bool() ||
+                compiler::compile("false && 1").evaluate().as_bool())
+                throw std::runtime_error("Wrong short-circuit result");
+
+            // LOAD x, then a jump over LOAD y and its type check
+            const compiler::CompiledExpression both =
+                compiler::compile("x && y");
+            const std::vector<compiler::Instruction> &code = both.get_code();
+            if (code.size() != 4 ||
+                code[1].op != compiler::OpCode::JUMP_IF_FALSE ||
+                code[1].operand != 2 ||
+                code[3].op != compiler::OpCode::REQUIRE_BOOL)
+                throw std::runtime_error("Unexpected short-circuit code");
+
+            const std::vector<compiler::Instruction> straight =
+                compiler::remove_jumps(program.get_code());
+            const std::vector<compiler::Instruction> jumps =
+                compiler::insert_jumps(straight);
+            bool same = jumps.size() == program.get_code().size();
+            for (size_t index = 0; same && index < jumps.size(); index++)
+                same = jumps[index].op == program.get_code()[index].op &&
+                       jumps[index].operand ==
+                           program.get_code()[index].operand;
+            if (!same || straight.size() != program.get_code().size() - 2)
+                throw std::runtime_error("Jumps do not round-trip");
+        }
+
+        {
+            // Programs evaluate in place from a serialized image
+            std::string deep = "x";
+            for (int depth = 0; depth < 80; depth++)
+                deep = "(" + std::to_string(depth) + " - " + deep + ")";
+            const std::string_view layout[] = {"x", "y"};
+            const std::vector<compiler::CompiledExpression> programs = {
+                compiler::compile("2.0 ^ 10 > 1000"),
+                compiler::compile("price * qty - 0.5"),
+                compiler::compile("x != 0 && 10 / x > 1 || y < 2", layout),
+                compiler::optimize(compiler::compile(deep + " * 2 + 1")),
+                compiler::optimize(compiler::compile("(x - 3) ^ 3", layout))};
+
+            const std::string bytes = serialization::serialize(programs);
+            const serialization::ProgramImage image(bytes);
+            const Value row[] = {Value{0}, Value{1}};
+            bool same = image.size() == programs.size();
+            for (size_t index = 0; same && index < programs.size(); index++)
+                same = image[index].evaluate(row).to_string() ==
+                           programs[index].evaluate(row).to_string() &&
+                       image[index].get_code().size() ==
+                           programs[index].get_code().size() &&
+                       image[index].get_max_stack_depth() ==
+                           programs[index].get_max_stack_depth();
+            if (!same || image[1].get_variable_count() != 2 ||
+                image[1].get_variable(1) != "qty" ||
+                image[1].find_variable("price") != 0u ||
+                image[0].find_variable("price") ||
+                image[2].try_evaluate().has_value())
+                throw std::runtime_error("Serialized programs differ");
+
+            const std::filesystem::path path =
+                std::filesystem::temp_directory_path() /
+                "expression_evaluator_programs_test.bin";
+            std::ofstream(path, std::ios::binary) << bytes;
+            const serialization::ProgramFile file(path.string());
+            std::filesystem::remove(path);
+            if (file.get_image()[1].evaluate(row).as_number() != -0.5)
+                throw std::runtime_error("Wrong result from program file");
+
+            expect_throws("corrupt image", [&bytes]() {
+                std::string corrupt = bytes;
+                corrupt[corrupt.size() / 2] ^= 1;
+                (void)serialization::ProgramImage(corrupt);
+            });
+            expect_throws("truncated image", [&bytes]() {
+                (void)serialization::ProgramImage(
+                    std::string_view(bytes).substr(0, bytes.size() - 8));
+            });
+            expect_throws("unsupported image version", [&bytes]() {
+                std::string newer = bytes;
+                newer[offsetof(serialization::ImageHeader, version)] =
+                    serialization::FORMAT_VERSION + 1;
+                (void)serialization::ProgramImage(newer);
+            });
+            // Recompute the checksum, FNV-1a with its own field as zero, of
+            // an image changed on purpose
+            const auto reseal = [](std::string &changed) {
+                const size_t field =
+                    offsetof(serialization::ImageHeader, checksum);
+                std::memset(changed.data() + field, 0, sizeof(std::uint64_t));
+                std::uint64_t hash = 14695981039346656037u;
+                for (const char byte : changed)
+                    hash = (hash ^ static_cast<unsigned char>(byte)) *
+                           1099511628211u;
+                std::memcpy(changed.data() + field, &hash, sizeof(hash));
+            };
+            {
+                // Images from before DUPLICATE are still read
+                const compiler::CompiledExpression older_programs[] = {
+                    compiler::compile("price * qty - 0.5")};
+                std::string older = serialization::serialize(older_programs);
+                older[offsetof(serialization::ImageHeader, version)] =
+                    serialization::OLDEST_FORMAT_VERSION;
+                reseal(older);
+
+                const Value prices[] = {Value{2}, Value{3}};
+                if (serialization::ProgramImage(older)[0]
+                        .evaluate(prices)
+                        .as_number() != 5.5)
+                    throw std::runtime_error("Version 1 image not read");
+
+                // Which cannot contain DUPLICATE. Nothing emits it any more,
+                // so x * 2 becomes x * x by replacing the push of 2
+                const compiler::CompiledExpression doubled[] = {
+                    compiler::compile("x * 2")};
+                std::string duplicated = serialization::serialize(doubled);
+                size_t push = 0;
+                std::memcpy(&push,
+                            duplicated.data() +
+                                sizeof(serialization::ImageHeader) +
+                                offsetof(serialization::ProgramRecord,
+                                         code_offset),
+                            sizeof(push));
+                duplicated[push + sizeof(compiler::Instruction)] =
+                    static_cast<char>(compiler::OpCode::DUPLICATE);
+                reseal(duplicated);
+                const Value three[] = {Value{3}};
+                if (serialization::ProgramImage(duplicated)[0]
+                        .evaluate(three)
+                        .as_number() != 9.0)
+                    throw std::runtime_error("Wrong DUPLICATE result");
+
+                duplicated[offsetof(serialization::ImageHeader, version)] =
+                    serialization::OLDEST_FORMAT_VERSION;
+                reseal(duplicated);
+                expect_throws("DUPLICATE in a version 1 image", [&]() {
+                    (void)serialization::ProgramImage(duplicated);
+                });
+            }
+            {
+                // Records that pass the checksum but would read out of
+                // bounds are rejected when the image is opened
+                const auto damage = [&](size_t offset, auto value) {
+                    std::string damaged = bytes;
+                    std::memcpy(damaged.data() + offset, &value,
+                                sizeof(value));
+                    reseal(damaged);
+                    (void)serialization::ProgramImage(damaged);
+                };
+                constexpr size_t records = sizeof(serialization::ImageHeader);
+                constexpr size_t record = sizeof(serialization::ProgramRecord);
+                size_t code = 0;
+                std::memcpy(&code,
+                            bytes.data() + records +
+                                offsetof(serialization::ProgramRecord,
+                                         code_offset),
+                            sizeof(code));
+
+                expect_throws("too many programs", [&]() {
+                    damage(offsetof(serialization::ImageHeader,
+                                    program_count),
+                           std::uint32_t{1000});
+                });
+                expect_throws("code out of bounds", [&]() {
+                    damage(records + offsetof(serialization::ProgramRecord,
+                                              code_offset),
+                           std::uint64_t{bytes.size()});
+                });
+                expect_throws("variables out of bounds", [&]() {
+                    damage(records + record +
+                               offsetof(serialization::ProgramRecord,
+                                        variable_count),
+                           std::uint32_t{1} << 30);
+                });
+                expect_throws("unknown opcode",
+                              [&]() { damage(code, std::uint8_t{0xff}); });
+                expect_throws("constant out of bounds", [&]() {
+                    damage(code + 4, std::uint32_t{99});
+                });
+                expect_throws("understated stack depth", [&]() {
+                    damage(records + offsetof(serialization::ProgramRecord,
+                                              max_stack_depth),
+                           std::uint32_t{1});
+                });
+
+                // The jump of x != 0 && ... || y < 2
+                size_t jump = 0;
+                while (programs[2].get_code()[jump].op !=
+                       compiler::OpCode::JUMP_IF_FALSE)
+                    jump++;
+                size_t jumps = 0;
+                std::memcpy(&jumps,
+                            bytes.data() + records + 2 * record +
+                                offsetof(serialization::ProgramRecord,
+                                         code_offset),
+                            sizeof(jumps));
+                jumps += jump * sizeof(compiler::Instruction) + 4;
+                expect_throws("jump past the end", [&]() {
+                    damage(jumps, std::uint32_t{1000});
+                });
+                // Into the middle of 10 / x, with one more value
+                expect_throws("jump to another depth", [&]() {
+                    damage(jumps, std::uint32_t{2});
+                });
+            }
+            expect_throws("misaligned image", [&bytes]() {
+                const std::string shifted = " " + bytes;
+                (void)serialization::ProgramImage(
+                    std::string_view(shifted).substr(1));
+            });
+        }
+
+        expect_same_columnar("x + y * 2 - -x / y");
+        expect_same_columnar("x ^ 2 + y ^ 0.5");
+        expect_same_columnar("(x - y) ^ 3 + x ^ 4 > y ^ 2");
+        expect_same_columnar("x > 0 && y <= 50 || x == -3");
+        expect_same_columnar("(x != y) == (x < y) || x >= 4");
+        expect_same_columnar("x + 0 * y");
+        expect_same_columnar("false && x");
+        expect_same_columnar("x * 1 + --y / 1 > 2 ^ 3 && true");
+        // Divisions by zero skipped by && must not raise
+        expect_same_columnar("x != 0 && 10 / x > 1 || y < 2");
+
+        // Compile-time expressions
+        static_assert("1 + 2 * 3"_expr.evaluate() == 7.0);
+        static_assert("x > 1 && y < 2"_expr.evaluate(3, 1));
+        static_assert(std::is_same_v<decltype("x * 2"_expr)::result_type,
+                                     double>);
+        static_assert(decltype("b + a * b"_expr)::get_variables()[1] == "a");
+        expect_same_static<"2 ^ 3 ^ 2">();
+        expect_same_static<"-2^2 + -(1 + 2)">();
+        expect_same_static<"5. + .25 - 0.1 * 3">();
+        expect_same_static<"99999999999999999999 / 7">();
+        expect_same_static<"3.14159 * r ^ 2">(1.5);
+        expect_same_static<"2 ^ 10 + r ^ 3 + r ^ 0.5">(1.7);
+        static_assert("2 ^ 10 + 3 ^ 4"_expr.evaluate() == 1105.0);
+        // Outside constant evaluation, rejections carry the token's offset
+        try {
+            (void)static_expression::detail::parse<5>("1 + $");
+            throw std::runtime_error("Expected a rejected static expression");
+        } catch (const std::invalid_argument &e) {
+            const std::string_view message = e.what();
+            if (message != "Unexpected character at offset 4")
+                throw std::runtime_error("Wrong static rejection: " +
+                                         std::string(e.what()));
+        }
+        expect_same_static<"(a - b) / (a + b) >= 0.25">(3, 1);
+        expect_same_static<"(x > 1) == (y <= x) != false">(2, 2.5);
+        expect_same_static<"x != 0 && 10 / x > 1 || y < 2">(0, 1);
+        expect_same_static<"x != 0 && 10 / x > 1 || y < 2">(4, 3);
+        expect_same_static<"9007199254740993 - 9007199254740992 + x">(0);
+        expect_same_static<"2 ^ 63 - (2 ^ 63 - 1) + x">(0);
+        expect_same_static<"2 ^ 53 + 1 > 2 ^ 53 && x < 1">(0);
+        expect_same_static<"x * (0 * -5)">(1);
+        static_assert("-(2 ^ 62) * 2 - 1 + x"_expr.evaluate(0) ==
+                      -9223372036854775808.0);
+
+        // Folding. The compiler already combines integer literals exactly,
+        // so decimals are used to leave the work to the optimizer
+        expect_same_optimized("1 + 2 * 3", 0);
+        expect_same_optimized("1. + 2. * 3.", 4);
+        expect_same_optimized("-(1. + 2.) * .5", 5);
+        expect_same_optimized("(3. > 2) == (1. != 1) || true && false", 12);
+        expect_same_optimized("x + 2. * 3 - 4 ^ 0.5", 4);
+        // Identities, with a type check left for variables
+        expect_same_optimized("x * 1", 1);
+        expect_same_optimized("1 * x / 1. ^ 1", 5);
+        expect_same_optimized("x - 0", 1);
+        expect_same_optimized("x + 0", 0);
+        expect_same_optimized("x - -0", 1);
+        expect_same_optimized("--x", 1);
+        expect_same_optimized("---x + ----y", 4);
+        expect_same_optimized("true && x", 2);
+        expect_same_optimized("x || false", 2);
+        expect_same_optimized("(x > 1) && true", 3);
+        expect_same_optimized("false && x && y", 6);
+        expect_same_optimized("true || x == y", 5);
+        expect_same_optimized("false && x", 3);
+        // The right operand is never evaluated, so its errors go too
+        expect_same_optimized("false && x / 0", 5);
+        // Errors are left for evaluation
+        expect_same_optimized("1 / 0", 0);
+        expect_same_optimized("x + 1 / (2. - 2)", 2);
+        expect_same_optimized("true + 1", 0);
+        expect_same_optimized("-true * 1", 2);
+        expect_same_optimized("1 == true || x", 0);
+        // Powers are never expanded into products, which could round
+        // differently from std::pow
+        expect_same_optimized("x ^ 2", 0);
+        expect_same_optimized("(x - y) ^ 3 + x ^ 4 * y ^ 2 > 1", 0);
+        expect_same_optimized("(x && y) ^ 2", 0);
+        {
+            const compiler::CompiledExpression cube =
+                compiler::compile("(x + 1) ^ 3");
+            const Value base[] = {Value{0.1}};
+            if (compiler::optimize(cube).evaluate(base).as_number() !=
+                std::pow(0.1 + 1.0, 3.0))
+                throw std::runtime_error("Optimized power differs");
+        }
+
+        {
+            cache::ExpressionCache expressions;
+            const compiler::CompiledExpression &first =
+                expressions.get("2 ^ 10 > 1000");
+            if (&expressions.get("2 ^ 10 > 1000") != &first ||
+                !first.evaluate().as_bool() ||
+                expressions.get("x + 1").get_variables().size() != 1)
+                throw std::runtime_error("Wrong cached program");
+
+            const cache::CacheStats &stats = expressions.get_stats();
+            if (stats.hits != 1 || stats.misses != 2 || stats.evictions != 0)
+                throw std::runtime_error("Unexpected cache counters");
+
+            // Invalid expressions are not cached
+            expect_throws("cached syntax error",
+                          [&]() { (void)expressions.get("1 +"); });
+            if (expressions.size() != 2 || stats.misses != 3)
+                throw std::runtime_error("Invalid expression was cached");
+
+            // A budget that only fits a few programs evicts the least
+            // recently used ones
+            expressions.set_memory_budget(expressions.get_memory_usage());
+            (void)expressions.get("2 ^ 10 > 1000");
+            (void)expressions.get("1 + 2");
+            if (expressions.get_memory_usage() >
+                    expressions.get_memory_budget() ||
+                stats.evictions == 0)
+                throw std::runtime_error("Cache exceeded its budget");
+
+            const size_t misses = stats.misses;
+            (void)expressions.get("1 + 2");
+            if (stats.misses != misses ||
+                expressions.get("x + 1").get_variables().size() != 1 ||
+                stats.misses != misses + 1)
+                throw std::runtime_error("Cache evicted the wrong program");
+
+            expressions.clear();
+            if (expressions.size() != 0 || expressions.get_memory_usage() != 0)
+                throw std::runtime_error("Cache was not cleared");
+        }
+
+        {
+            stats::set_enabled(true);
+            stats::reset();
+            (void)eval("1 + 2 * 3");
+            expect_throws("counted syntax error",
+                          []() { (void)evaluator::evaluate("1 +"); });
+            const Value two[] = {Value{2}};
+            (void)compiler::compile("x * 2").evaluate(two);
+
+            // Worker threads record into their own counters, which outlive
+            // them
+            std::string lines;
+            for (size_t line = 0; line < 20000; line++)
+                lines += "1 + 2\n";
+            std::FILE *stream = std::tmpfile();
+            {
+                batch::BufferedWriter output(stream);
+                (void)batch::evaluate_lines(lines, output, 2);
+            }
+            std::fclose(stream);
+
+            stats::set_enabled(false);
+            (void)eval("1 + 2");
+
+            const stats::Snapshot counted = stats::snapshot();
+            const stats::StageStats &tokenize =
+                counted[stats::Stage::TOKENIZE];
+            const stats::StageStats &evaluate =
+                counted[stats::Stage::EVALUATE];
+            if (stats::COMPILED_IN &&
+                (tokenize.calls != 20002 || tokenize.tokens != 60008 ||
+                 counted[stats::Stage::TO_POSTFIX].tokens != 60008 ||
+                 counted[stats::Stage::EVALUATE_POSTFIX].tokens != 5 ||
+                 counted[stats::Stage::COMPILE].calls != 20001 ||
+                 counted[stats::Stage::EXECUTE].calls != 20001 ||
+                 evaluate.calls != 2 || evaluate.errors != 1 ||
+                 counted.exceptions != 1 ||
+                 counted.to_string().find("evaluate_postfix") ==
+                     std::string::npos))
+                throw std::runtime_error("Wrong stage counters:\n" +
+                                         counted.to_string());
+            if (!stats::COMPILED_IN && evaluate.calls != 0)
+                throw std::runtime_error("Stats recorded when compiled out");
+
+            for (const stats::StageStats &stage : counted.stages) {
+                std::uint64_t histogram_calls = 0;
+                for (const std::uint64_t calls : stage.histogram)
+                    histogram_calls += calls;
+                if (histogram_calls != stage.calls ||
+                    stage.percentile_nanoseconds(0.5) >
+                        stage.percentile_nanoseconds(0.99))
+                    throw std::runtime_error("Inconsistent stage histogram");
+            }
+
+            stats::reset();
+            if (stats::snapshot()[stats::Stage::EVALUATE].calls != 0)
+                throw std::runtime_error("Stats were not reset");
+        }
+
+        {
+            // The shared x / y fails when y is 0, which only some of the
+            // expressions reading it see
+            const std::string_view rules[] = {
+                "x / y > 1",          "x / y < 3",
+                "y == 0 || x / y > 1", "(x - y) / y >= 0.5",
+                "-(x - y) / y",       "x && y || x == y",
+                "x + true",           "true && x / y > 1",
+                "x == y",             "2 ^ x - x ^ 2"};
+            expect_same_set(rules);
+
+            expression_set::ExpressionSet set;
+            for (const std::string_view rule : rules)
+                (void)set.add(rule);
+            if (set.get_variables().size() != 2 ||
+                set.get_node_count() * 2 > set.get_instruction_count())
+                throw std::runtime_error("Subexpressions were not shared");
+
+            const Value bindings[] = {Value{6.0}, Value{2.0}};
+            std::vector<Value> values(set.size(), Value{0.0});
+            expect_throws("shared type error",
+                          [&]() { set.evaluate(bindings, values); });
+            expect_throws("missing shared bindings", [&]() {
+                set.evaluate(std::span(bindings, 1), values);
+            });
+            expect_throws("invalid shared expression",
+                          [&]() { (void)set.add("x +"); });
+            if (set.size() != std::size(rules))
+                throw std::runtime_error("Invalid expression was added");
+
+            expression_set::ExpressionSet valid;
+            (void)valid.add("x / y > 1");
+            (void)valid.add("(x / y > 1) == (y < x)");
+            valid.evaluate(bindings, values);
+            if (!values[0].as_bool() || !values[1].as_bool())
+                throw std::runtime_error("Wrong shared results");
+        }
+
+        {
+            graph::ExpressionGraph sheet;
+            sheet.set_input("price", Value{2.5});
+            sheet.set_input("quantity", Value{4});
+            // Formulas may read names defined later
+            sheet.define("large", "taxed > 10");
+            sheet.define("taxed", "total * 1.2");
+            sheet.define("total", "price * quantity");
+            sheet.define("next", "quantity + 1");
+            if (!sheet.get("large").as_bool() ||
+                sheet.get("taxed").as_number() != 12.0 ||
+                sheet.get_evaluation_count() != 4)
+                throw std::runtime_error("Wrong graph values");
+
+            // Only formulas depending on the input are re-evaluated, each
+            // after what it reads
+            sheet.set_input("price", Value{1});
+            if (sheet.get_dirty_count() != 3 || sheet.recalculate() != 3 ||
+                sheet.get("large").as_bool() ||
+                sheet.get("taxed").as_number() != 4.8 ||
+                sheet.get("next").as_number() != 5.0)
+                throw std::runtime_error("Wrong incremental graph values");
+
+            sheet.set_input("price", Value{1});
+            if (sheet.get_dirty_count() != 0)
+                throw std::runtime_error("Unchanged input marked dirty");
+
+            // Unknown names and errors propagate to dependents
+            sheet.define("total", "price * quantity - discount");
+            Result<Value> large = sheet.try_get("large");
+            if (large ||
+                large.get_error().message() != "Unbound variable: discount")
+                throw std::runtime_error("Unbound graph name not reported");
+            sheet.set_input("discount", Value{true});
+            large = sheet.try_get("large");
+            if (large ||
+                large.get_error().get_code() != ErrorCode::EXPECTED_NUMBER)
+                throw std::runtime_error("Graph error not propagated");
+
+            // Formulas can become inputs and inputs formulas
+            sheet.define("discount", "quantity / 4");
+            sheet.set_input("total", Value{100});
+            if (sheet.get("taxed").as_number() != 120.0 ||
+                !sheet.get_dependencies("total").empty() ||
+                sheet.get_dependencies("discount").size() != 1)
+                throw std::runtime_error("Wrong redefined graph values");
+
+            // Cycles are rejected when defined, leaving the graph unchanged
+            const size_t evaluations = sheet.get_evaluation_count();
+            const Result<void> cycle = sheet.try_define("total", "large + 1");
+            if (cycle ||
+                cycle.get_error().get_code() !=
+                    ErrorCode::CIRCULAR_REFERENCE ||
+                cycle.get_error().message() != "Circular reference: total")
+                throw std::runtime_error("Graph cycle not rejected");
+            expect_throws("self-referencing formula",
+                          [&]() { sheet.define("x", "x + 1"); });
+            expect_throws("invalid formula",
+                          [&]() { sheet.define("total", "1 +"); });
+            if (sheet.contains("x") || sheet.get_dirty_count() != 0 ||
+                sheet.get("total").as_number() != 100.0 ||
+                sheet.get_evaluation_count() != evaluations)
+                throw std::runtime_error("Rejected formula changed the graph");
+
+            expect_throws("unknown graph name",
+                          [&]() { (void)sheet.get("missing"); });
+        }
+
+        {
+            const std::filesystem::path path =
+                std::filesystem::temp_directory_path() /
+                "expression_evaluator_batch_test.txt";
+            std::ofstream(path, std::ios::binary)
+                << "1 + 2\n\n0.1 + 0.2\r\n1 / 0\n-(0)\n2 ^ 2000\ntrue && false";
+            const MappedFile input(path.string());
+            std::filesystem::remove(path);
+
+            // A tiny buffer, so that lines are split across flushes
+            std::FILE *stream = std::tmpfile();
+            batch::BufferedWriter output(stream, 8);
+            const batch::BatchStats stats =
+                batch::evaluate_lines(input.get_contents(), output);
+
+            // Numbers are formatted without allocating, exactly as
+            // Value::to_string does
+            std::string expected = "3\n\n0.30000000000000004\nerror: Math "
+                                   "error: division by zero\n-0\ninf\nfalse\n";
+            for (const double number : {1e300, 1.5e-300, 123456789.125,
+                                        -std::nan(""), 1.0 / 3.0}) {
+                output.write(Value{number});
+                expected += Value{number}.to_string();
+            }
+            output.flush();
+
+            std::string written(256, '\0');
+            std::rewind(stream);
+            written.resize(
+                std::fread(written.data(), 1, written.size(), stream));
+            std::fclose(stream);
+
+            if (written != expected || stats.lines != 7 || stats.errors != 1)
+                throw std::runtime_error("Unexpected batch output: " + written);
+        }
+
+        {
+            // Lines evaluate as compiled programs, which short-circuit, and
+            // report the unbound variable as nothing binds it
+            const auto line = [](std::string_view expression) {
+                const Result<Value> result =
+                    batch::try_evaluate_line(expression);
+                return result ? result.value().to_string()
+                              : result.get_error().message();
+            };
+            if (line("false && 1 / 0 > 0") != "false" ||
+                line("true || x") != "Unbound variable: x" ||
+                line("true && 1 / 0 > 0") != "Math error: division by zero" ||
+                line("true && 1") !=
+                    "Type error: Expected boolean, got number '1'" ||
+                line("false && x") != "Unbound variable: x" ||
+                line("1 / 0 + x") != "Unbound variable: x" ||
+                line("2 ^ 10") != "1024")
+                throw std::runtime_error("Unexpected batch line semantics");
+
+            // The streaming pass stops at the first evaluation error, before
+            // lexing the rest of the line, while lines report lexing and
+            // parsing errors first
+            const Result<Value> streamed = evaluator::try_evaluate("1 / 0 + $");
+            if (streamed || streamed.get_error().get_code() !=
+                                ErrorCode::DIVISION_BY_ZERO ||
+                line("1 / 0 + $") != "Unexpected character: '$'" ||
+                line("1 / 0 + (") != "Syntax error: mismatched parentheses" ||
+                line("true + 1 + 1.2.3") !=
+                    "Invalid number: multiple decimal points")
+                throw std::runtime_error("Unexpected batch error ordering");
+        }
+
+        {
+            // Enough lines for many chunks, so that threads steal work, with
+            // errors, blank lines and a final line without a newline
+            std::string input;
+            for (int line = 0; line < 40000; line++) {
+                if (line % 7 == 0)
+                    input += "1 / (2 - 2)";
+                else if (line % 5 != 0)
+                    input += std::to_string(line) + " * 3 > 10000";
+                input += '\n';
+            }
+            input += "2 ^ 0.5";
+
+            std::string expected;
+            batch::BatchStats expected_stats;
+            for (const unsigned threads : {1u, 2u, 3u, 8u}) {
+                std::FILE *stream = std::tmpfile();
+                batch::BufferedWriter output(stream);
+                const batch::BatchStats stats =
+                    batch::evaluate_lines(input, output, threads);
+                output.flush();
+
+                std::string written(input.size() * 2, '\0');
+                std::rewind(stream);
+                written.resize(
+                    std::fread(written.data(), 1, written.size(), stream));
+                std::fclose(stream);
+
+                if (threads == 1) {
+                    expected = written;
+                    expected_stats = stats;
+                } else if (written != expected ||
+                           stats.lines != expected_stats.lines ||
+                           stats.errors != expected_stats.errors)
+                    throw std::runtime_error(
+                        "Parallel batch output differs with " +
+                        std::to_string(threads) + " threads");
+            }
+
+            if (expected_stats.lines != 40001 ||
+                expected_stats.errors != 5715)
+                throw std::runtime_error("Unexpected parallel batch counts");
+        }
+
+        {
+            // A long generated expression through the streaming pipeline
+            std::string expression = "0";
+            for (int term = 0; term < 100000; term++)
+                expression += term % 2 == 0 ? " + 3" : " - 1";
+
+            const Value result = evaluator::evaluate(expression);
+            if (result.as_number() != 100000.0)
+                throw std::runtime_error("Wrong streaming result: " +
+                                         result.to_string());
+        }
+
+        {
+            // Errors returned rather than thrown, with where they occurred
+            expect_error("1 + $", ErrorCode::UNEXPECTED_CHARACTER, 4);
+            expect_error("1.2.3", ErrorCode::MULTIPLE_DECIMAL_POINTS, 0);
+            expect_error("(1 + 2", ErrorCode::MISMATCHED_PARENTHESES, 0);
+            expect_error("1 + 2)", ErrorCode::MISMATCHED_PARENTHESES, 5);
+            expect_error("2 * x + 1", ErrorCode::UNBOUND_VARIABLE, 4);
+            expect_error("1 +", ErrorCode::INSUFFICIENT_OPERANDS, 2);
+            expect_error("1 2", ErrorCode::TOO_MANY_OPERANDS, std::nullopt);
+            expect_error("true + 1", ErrorCode::EXPECTED_NUMBER, 5);
+            expect_error("1 && true", ErrorCode::EXPECTED_BOOLEAN, 2);
+            expect_error("1 == true", ErrorCode::TYPE_MISMATCH, 2);
+            expect_error("1 / 0", ErrorCode::DIVISION_BY_ZERO, 2);
+
+            const std::string_view layout[] = {"x"};
+            const Result<compiler::CompiledExpression> unknown =
+                compiler::try_compile("x + yz", layout);
+            if (unknown || unknown.get_error().get_code() !=
+                               ErrorCode::UNKNOWN_VARIABLE ||
+                unknown.get_error().get_source_offset() != 4u ||
+                unknown.get_error().message() != "Unknown variable: yz")
+                throw std::runtime_error("Wrong unknown variable error");
+
+            // An empty fixed layout allows no variables at all
+            const Result<compiler::CompiledExpression> no_variables =
+                compiler::try_compile("2 * x", {});
+            if (no_variables || no_variables.get_error().get_code() !=
+                                    ErrorCode::UNKNOWN_VARIABLE ||
+                compiler::compile("2 * 3", {}).evaluate().as_number() != 6.0)
+                throw std::runtime_error("Empty layout accepted a variable");
+
+            const compiler::CompiledExpression program =
+                compiler::compile("x / y > 1 && z");
+            const Value zero[] = {Value{1.0}, Value{0.0}, Value{true}};
+            const Value boolean[] = {Value{4.0}, Value{2.0}, Value{3.0}};
+            const Value valid[] = {Value{4.0}, Value{2.0}, Value{true}};
+            const Result<Value> divided = program.try_evaluate(zero);
+            const Result<Value> typed = program.try_evaluate(boolean);
+            const Result<Value> missing = program.try_evaluate({});
+            if (divided ||
+                divided.get_error().get_code() !=
+                    ErrorCode::DIVISION_BY_ZERO ||
+                divided.get_error().get_source_offset() ||
+                typed ||
+                typed.get_error().message() !=
+                    "Type error: Expected boolean, got number '3'" ||
+                missing ||
+                missing.get_error().message() !=
+                    "Missing variable bindings: expected 3, got 0" ||
+                !program.try_evaluate(valid).value().as_bool())
+                throw std::runtime_error("Wrong compiled errors");
+        }
+
         expect_throws("type error (1 && true)", []() { eval("1 && true"); });
         expect_throws("type error (true + 1)", []() { eval("true + 1"); });
         expect_throws("type error (true > false)",
@@ -115,6 +1247,62 @@ int main() {
         expect_throws("unary minus on bool", []() { eval("-true"); });
         expect_throws("division by zero", []() { eval("1 / 0"); });
         expect_throws("mismatched parentheses", []() { eval("(1 + 2"); });
+        expect_throws("streaming type error",
+                      []() { (void)evaluator::evaluate("1 && true"); });
+        expect_throws("streaming mismatched parentheses",
+                      []() { (void)evaluator::evaluate("(1 + 2"); });
+        expect_throws("streaming unmatched right parenthesis",
+                      []() { (void)evaluator::evaluate("1 + 2)"); });
+        expect_throws("streaming too many operands",
+                      []() { (void)evaluator::evaluate("1 2"); });
+        expect_throws("multiple decimal points", []() { eval("1.2.3"); });
+        expect_throws("unexpected character", []() { eval("1 $ 2"); });
+
+        expect_throws("compile missing operand",
+                      []() { (void)compiler::compile("1 +"); });
+        expect_throws("compile too many operands",
+                      []() { (void)compiler::compile("1 2"); });
+        expect_throws("unbound variable", []() { eval("x + 1"); });
+        expect_throws("missing bindings",
+                      []() { (void)compiler::compile("x + 1").evaluate(); });
+        expect_throws("unknown variable in fixed layout", []() {
+            const std::string_view layout[] = {"x"};
+            (void)compiler::compile("x + y", layout);
+        });
+        expect_throws("bool bound to arithmetic", []() {
+            const Value bindings[] = {Value{true}};
+            (void)compiler::compile("x + 1").evaluate(bindings);
+        });
+        expect_throws("columnar division by zero", []() {
+            const double x[] = {1.0, 2.0, 3.0, 0.0, 5.0};
+            const double *columns[] = {x};
+            double output[5];
+            (void)columnar::evaluate(compiler::compile("1 / x"), columns, 5,
+                                     output);
+        });
+        expect_throws("columnar type error", []() {
+            const double x[] = {1.0};
+            const double *columns[] = {x};
+            double output[1];
+            (void)columnar::evaluate(compiler::compile("x > 0 && 1"), columns,
+                                     1, output);
+        });
+        expect_throws("compiled short-circuit type error", []() {
+            (void)compiler::compile("1 && false").evaluate();
+        });
+        expect_throws("compiled right operand type error", []() {
+            (void)compiler::compile("true && 1").evaluate();
+        });
+        expect_throws("compiled right operand division by zero", []() {
+            (void)compiler::compile("false || 1 / 0 > 1").evaluate();
+        });
+        expect_throws("static division by zero",
+                      []() { (void)"1 / (x - 2)"_expr.evaluate(2); });
+        expect_throws("compiled division by zero", []() {
+            const compiler::CompiledExpression program =
+                compiler::compile("1 / (2 - 2)");
+            (void)program.evaluate();
+        });
 
         return 0;
     } catch (const std::exception &e) {